@@ -0,0 +1,73 @@
+#include "Aot.h"
+#include "Emulator.h"
+
+#include <cstdio>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#define AOT_MODULE_EXTENSION ".dll"
+#else
+#include <dlfcn.h>
+#define AOT_MODULE_EXTENSION ".so"
+#endif
+
+Aot::~Aot() {
+    unload();
+}
+
+std::string Aot::module_path(uint64_t rom_hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)rom_hash);
+    return std::string(AOT_DIRECTORY) + name + AOT_MODULE_EXTENSION;
+}
+
+bool Aot::load(uint64_t rom_hash, uint32_t rom_size) {
+    unload();
+    std::string path = module_path(rom_hash);
+#ifdef _WIN32
+    library = (void*)LoadLibraryA(path.c_str());
+    if (!library)
+        return false;
+    AotModuleFn get_module = (AotModuleFn)GetProcAddress((HMODULE)library, AOT_MODULE_SYMBOL);
+#else
+    library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library)
+        return false;
+    AotModuleFn get_module = (AotModuleFn)dlsym(library, AOT_MODULE_SYMBOL);
+#endif
+    const AotModule* candidate = get_module ? get_module() : nullptr;
+    if (!candidate || candidate->abi_version != AOT_ABI_VERSION || candidate->rom_hash != rom_hash || candidate->rom_size != rom_size) {
+        std::cout << "Ignoring stale AOT module " << path << std::endl;
+        unload();
+        return false;
+    }
+
+    module = candidate;
+    entries.assign(MEM_SIZE, nullptr);
+    code_map.assign(MEM_SIZE, 0);
+    for (uint32_t i = 0; i < module->block_count; i++) {
+        const AotBlock& block = module->blocks[i];
+        entries[block.address] = &block;
+        for (uint32_t address = block.address; address < block.end && address < MEM_SIZE; address++) {
+            code_map[address] = 1;
+        }
+    }
+    std::cout << "Loaded AOT module " << path << " (" << module->block_count << " blocks)" << std::endl;
+    return true;
+}
+
+void Aot::unload() {
+    module = nullptr;
+    invalidated = false;
+    entries.clear();
+    code_map.clear();
+    if (library) {
+#ifdef _WIN32
+        FreeLibrary((HMODULE)library);
+#else
+        dlclose(library);
+#endif
+        library = nullptr;
+    }
+}
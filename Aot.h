@@ -0,0 +1,33 @@
+#pragma once
+#include "AotAbi.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define AOT_DIRECTORY "./aot/"
+
+// Loads the ahead-of-time compiled module for a ROM, found by hash under AOT_DIRECTORY
+class Aot
+{
+private:
+    void* library{ nullptr };
+    const AotModule* module{ nullptr };
+    std::vector<const AotBlock*> entries;   // Indexed by address
+    std::vector<uint8_t> code_map;
+public:
+    // Set when memory the module was compiled from is written, the module must then be unloaded
+    bool invalidated{ false };
+
+    Aot() = default;
+    Aot(const Aot&) = delete;
+    Aot& operator=(const Aot&) = delete;
+    ~Aot();
+
+    static std::string module_path(uint64_t rom_hash);
+    bool load(uint64_t rom_hash, uint32_t rom_size);
+    void unload();
+    bool loaded() const { return module != nullptr; }
+    const AotBlock* lookup(uint16_t address) const { return entries.empty() ? nullptr : entries[address]; }
+    bool is_code(uint16_t address) const { return !code_map.empty() && code_map[address]; }
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+
+// Interface between the Emulator and ROM modules generated by tools/ch8aot.cpp. Bump AOT_ABI_VERSION
+// whenever AotState or the module layout changes, old modules are then refused at load.
+#define AOT_ABI_VERSION 2
+
+#ifdef _WIN32
+#define AOT_EXPORT extern "C" __declspec(dllexport)
+#else
+#define AOT_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// The Emulator's machine state, as seen by compiled blocks
+struct AotState {
+    uint8_t* memory;
+    uint8_t* registers;
+    uint16_t* stack;
+    uint16_t* program_counter;
+    uint16_t* i_register;
+    uint8_t* stack_pointer;
+    void* emulator;
+    // Runs the handler for opcode, program_counter must already point past the instruction
+    void (*execute)(void* emulator, uint16_t opcode);
+};
+
+typedef void (*AotBlockFn)(AotState* state);
+
+struct AotBlock {
+    uint16_t address;
+    uint16_t end;       // One past the last byte the block was compiled from
+    uint16_t length;    // Instructions executed by one call
+    AotBlockFn function;
+};
+
+struct AotModule {
+    uint32_t abi_version;
+    uint64_t rom_hash;
+    uint32_t rom_size;
+    uint32_t block_count;
+    const AotBlock* blocks;
+};
+
+typedef const AotModule* (*AotModuleFn)();
+#define AOT_MODULE_SYMBOL "chip8_aot_module"
@@ -0,0 +1,104 @@
+#include "BlockCache.h"
+#include "Emulator.h"
+
+#include <algorithm>
+
+// Control flow, key waits and exits change program_counter outside of the straight line, and stores
+// may overwrite the block that is running, so all of them end a block.
+bool BlockCache::ends_block(OpKind kind) {
+    switch (kind) {
+    case OpKind::Return:
+    case OpKind::Exit:
+    case OpKind::Jump:
+    case OpKind::Call:
+    case OpKind::SkipEqImm:
+    case OpKind::SkipNeImm:
+    case OpKind::SkipEqReg:
+    case OpKind::SaveRange:
+    case OpKind::SkipNeReg:
+    case OpKind::JumpV0:
+    case OpKind::SkipKey:
+    case OpKind::SkipNotKey:
+    case OpKind::WaitKey:
+    case OpKind::Bcd:
+    case OpKind::Store:
+        return true;
+    default:
+        return false;
+    }
+}
+
+Block* BlockCache::compile(const uint8_t* memory, uint16_t address) {
+    if (blocks.empty()) {
+        blocks.resize(MEM_SIZE);
+        pages.resize(MEM_SIZE >> BLOCK_PAGE_SHIFT);
+        code_map.resize(MEM_SIZE);
+    }
+
+    std::unique_ptr<Block> block = std::make_unique<Block>();
+    block->start = address;
+    block->length = 0;
+    block->hits = 0;
+    block->native = nullptr;
+    uint32_t pc = address;
+    while (block->length < BLOCK_MAX_OPS && pc < MEM_SIZE - 1) {
+        uint16_t opcode = (memory[pc] << 8) | memory[pc + 1];
+        const Op& op = Emulator::decode_table[opcode];
+        block->ops[block->length++] = op;
+        OpKind kind = decode_kind(opcode);
+        // F000 carries its address in the following word
+        pc += kind == OpKind::LoadLongI ? 4 : 2;
+        if (ends_block(kind))
+            break;
+    }
+    if (block->length == 0) {
+        // A lone byte at the top of memory, execute it the way the interpreter would
+        block->ops[block->length++] = Emulator::decode_table[memory[pc] << 8];
+        pc += 2;
+    }
+    block->end = (uint16_t)std::min<uint32_t>(pc, MEM_SIZE);
+
+    uint32_t last = std::min<uint32_t>(pc, MEM_SIZE) - 1;
+    for (uint32_t i = address; i <= last; i++) {
+        code_map[i] = 1;
+    }
+    for (uint32_t page = address >> BLOCK_PAGE_SHIFT; page <= last >> BLOCK_PAGE_SHIFT; page++) {
+        pages[page].push_back(address);
+    }
+
+    blocks[address] = std::move(block);
+    return blocks[address].get();
+}
+
+void BlockCache::invalidate(uint16_t address) {
+    std::vector<uint16_t>& page = pages[address >> BLOCK_PAGE_SHIFT];
+    for (size_t i = 0; i < page.size();) {
+        Block* block = blocks[page[i]].get();
+        if (!block) {
+            // Already dropped through another page
+            page[i] = page.back();
+            page.pop_back();
+        }
+        else if (block->start <= address && address < block->end) {
+            blocks[page[i]].reset();
+            page[i] = page.back();
+            page.pop_back();
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void BlockCache::drop_native() {
+    for (std::unique_ptr<Block>& block : blocks) {
+        if (block)
+            block->native = nullptr;
+    }
+}
+
+void BlockCache::clear() {
+    blocks.clear();
+    pages.clear();
+    code_map.clear();
+}
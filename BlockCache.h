@@ -0,0 +1,43 @@
+#pragma once
+#include "Decoder.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define BLOCK_MAX_OPS 32
+#define BLOCK_PAGE_SHIFT 8
+
+// A straight-line run of predecoded instructions starting at `start`
+struct Block {
+    uint16_t start;
+    uint16_t end;       // One past the last byte the block was decoded from
+    uint8_t length;
+    uint32_t hits;      // Executions so far, used by the JIT to find hot blocks
+    void* native;       // Compiled code for this block, if any
+    Op ops[BLOCK_MAX_OPS];
+};
+
+class BlockCache
+{
+private:
+    std::vector<std::unique_ptr<Block>> blocks;     // Indexed by start address
+    std::vector<std::vector<uint16_t>> pages;       // Start addresses of the blocks touching each page
+    std::vector<uint8_t> code_map;                  // Non zero for every byte some block was decoded from
+
+    Block* compile(const uint8_t* memory, uint16_t address);
+public:
+    static bool ends_block(OpKind kind);
+    // Returns the block starting at address, decoding it from memory on a miss
+    Block& fetch(const uint8_t* memory, uint16_t address) {
+        if (!blocks.empty() && blocks[address])
+            return *blocks[address];
+        return *compile(memory, address);
+    }
+    bool is_code(uint16_t address) const { return !code_map.empty() && code_map[address]; }
+    // Drops every block that was decoded from address
+    void invalidate(uint16_t address);
+    // Forgets all compiled code while keeping the decoded blocks
+    void drop_native();
+    void clear();
+};
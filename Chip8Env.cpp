@@ -0,0 +1,57 @@
+#include "Chip8Env.h"
+#include "VecEnv.h"
+#include "RomPack.h"
+
+static_assert(CHIP8_ENV_PLANE_WORDS == VEC_ENV_PLANE_WORDS, "C and C++ plane layouts differ");
+
+struct Chip8Env {
+    VecEnv env;
+};
+
+Chip8Env* chip8_env_create(const uint8_t* rom, uint32_t rom_size, uint32_t count, uint32_t cycles_per_frame,
+    uint32_t max_frames, uint32_t threads, uint64_t seed) {
+    if ((!rom && rom_size) || count == 0 || cycles_per_frame == 0 || cycles_per_frame > MAX_CYCLES_PER_FRAME)
+        return nullptr;
+    return new Chip8Env{ VecEnv(rom, rom_size, count, cycles_per_frame, max_frames, threads, seed) };
+}
+
+Chip8Env* chip8_env_create_from_file(const char* path, uint32_t count, uint32_t cycles_per_frame,
+    uint32_t max_frames, uint32_t threads, uint64_t seed) {
+    MappedFile file;
+    if (!file.open(path))
+        return nullptr;
+    uint32_t size = (uint32_t)(file.size() < MAX_ROM_SIZE ? file.size() : MAX_ROM_SIZE);
+    return chip8_env_create(file.data(), size, count, cycles_per_frame, max_frames, threads, seed);
+}
+
+void chip8_env_destroy(Chip8Env* env) {
+    delete env;
+}
+
+uint32_t chip8_env_count(const Chip8Env* env) {
+    return (uint32_t)env->env.size();
+}
+
+void chip8_env_reset(Chip8Env* env, const uint8_t* which) {
+    env->env.reset(which);
+}
+
+void chip8_env_seed(Chip8Env* env, uint64_t seed) {
+    env->env.set_seed(seed);
+}
+
+void chip8_env_step(Chip8Env* env, const uint16_t* keys) {
+    env->env.step(keys);
+}
+
+const uint64_t* chip8_env_planes(const Chip8Env* env) {
+    return env->env.get_planes();
+}
+
+const uint8_t* chip8_env_done(const Chip8Env* env) {
+    return env->env.get_done();
+}
+
+const uint32_t* chip8_env_frames(const Chip8Env* env) {
+    return env->env.get_frames();
+}
@@ -0,0 +1,48 @@
+/* C interface to VecEnv, built as the chip8env shared library so agents written in other languages
+   can load it directly. Arrays returned by the getters are owned by the environment and stay valid
+   until chip8_env_destroy, their contents change on every step and reset. */
+#pragma once
+#include <stdint.h>
+
+#ifdef _WIN32
+#define CHIP8_ENV_API __declspec(dllexport)
+#else
+#define CHIP8_ENV_API __attribute__((visibility("default")))
+#endif
+
+/* uint64_t words of bitplanes per instance: plane 0 then plane 1, 64 rows of 2 words each. The most
+   significant bit of a row's first word is its leftmost pixel. */
+#define CHIP8_ENV_PLANE_WORDS 256
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Chip8Env Chip8Env;
+
+/* max_frames ends an episode after that many frames, 0 only ends it when the ROM exits. threads 0
+   uses every hardware thread. CXNN in every episode of every instance draws from its own generator,
+   derived from seed, the instance and the episode number. Returns NULL if the arguments are unusable. */
+CHIP8_ENV_API Chip8Env* chip8_env_create(const uint8_t* rom, uint32_t rom_size, uint32_t count,
+    uint32_t cycles_per_frame, uint32_t max_frames, uint32_t threads, uint64_t seed);
+/* As chip8_env_create with the ROM read from a file, NULL if it can't be read */
+CHIP8_ENV_API Chip8Env* chip8_env_create_from_file(const char* path, uint32_t count, uint32_t cycles_per_frame,
+    uint32_t max_frames, uint32_t threads, uint64_t seed);
+CHIP8_ENV_API void chip8_env_destroy(Chip8Env* env);
+
+CHIP8_ENV_API uint32_t chip8_env_count(const Chip8Env* env);
+/* which[i] non zero resets instance i, NULL resets all of them */
+CHIP8_ENV_API void chip8_env_reset(Chip8Env* env, const uint8_t* which);
+/* Seeds the episodes started by later resets and numbers them from 0 again, so runs can be repeated */
+CHIP8_ENV_API void chip8_env_seed(Chip8Env* env, uint64_t seed);
+/* keys[i] is the key mask of instance i, bit n set while key n is held. Instances that are done don't run. */
+CHIP8_ENV_API void chip8_env_step(Chip8Env* env, const uint16_t* keys);
+
+/* count * CHIP8_ENV_PLANE_WORDS words */
+CHIP8_ENV_API const uint64_t* chip8_env_planes(const Chip8Env* env);
+CHIP8_ENV_API const uint8_t* chip8_env_done(const Chip8Env* env);
+CHIP8_ENV_API const uint32_t* chip8_env_frames(const Chip8Env* env);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+// One RGBA8 display pixel, the layout the frontend uploads as a texture
+struct Color {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+    bool operator==(const Color& rhs) {
+        return (r == rhs.r && g == rhs.g && b == rhs.b && a == rhs.a);
+    }
+    Color operator^(const Color& rhs) {
+        return Color{ (uint8_t)(r ^ rhs.r), (uint8_t)(g ^ rhs.g), (uint8_t)(b ^ rhs.b), (uint8_t)(a ^ rhs.a) };
+    }
+    Color operator=(const Color& rhs) {
+        r = rhs.r;
+        g = rhs.g;
+        b = rhs.b;
+        a = rhs.a;
+        return *this;
+    }
+    Color operator^=(const Color& rhs) {
+        *this = *this ^ rhs;
+        return *this;
+    }
+};
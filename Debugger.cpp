@@ -0,0 +1,296 @@
+#include "Debugger.h"
+#include <SDL.h>
+
+#include <string>
+
+// MemoryEditor's write callback carries no user pointer, so render() publishes the emulator being drawn
+static Emulator* editor_target = nullptr;
+// Same for the highlight callback: addresses executed at least highlight_threshold times are highlighted
+static const Profiler* highlight_profile = nullptr;
+static uint64_t highlight_threshold = 0;
+
+Debugger::Debugger(Emulator& emulator) : emulator(emulator) {
+    next_frame = SDL_GetPerformanceCounter();
+    editor.Cols = 8;
+    editor.OptShowAscii = false;
+    editor.WriteFn = &Debugger::editor_write;
+    editor.HighlightFn = &Debugger::editor_highlight;
+
+    emulator.load_file("./roms/octojam1title.ch8");
+}
+
+void Debugger::editor_write(ImU8* data, size_t offset, ImU8 value) {
+    if (editor_target && data == editor_target->memory)
+        editor_target->write_memory((uint16_t)offset, value);
+    else
+        data[offset] = value;
+}
+
+bool Debugger::editor_highlight(const ImU8* data, size_t offset) {
+    if (!highlight_profile || !highlight_threshold || !editor_target || data != editor_target->memory)
+        return false;
+    // Both bytes of a hot instruction
+    return highlight_profile->executions[offset] >= highlight_threshold ||
+        (offset && highlight_profile->executions[offset - 1] >= highlight_threshold);
+}
+
+uint16_t Debugger::read_keys() {
+    uint16_t mask = 0;
+    for (int i = 0; i < 16; i++) {
+        if (ImGui::IsKeyDown(key_map[i]))
+            mask |= 1 << i;
+    }
+    return mask;
+}
+
+void Debugger::tick() {
+    // The clock is read once per call, the frames that are due then run without looking at it again
+    uint64_t now = SDL_GetPerformanceCounter();
+    uint64_t frame_period = SDL_GetPerformanceFrequency() / FRAME_RATE;
+    uint16_t keys = read_keys();
+    emulator.set_keys(keys);
+    // A movie keeps playing through exits, the recording was resumed after them
+    if (emulator.is_paused() && !replaying) {
+        // A movie only holds whole frames
+        if (step_once && !recorder.recording())
+            emulator.step();
+        step_once = false;
+        next_frame = now;
+    }
+    else {
+        for (int frames = 0; next_frame <= now && frames < MAX_CATCHUP_FRAMES; frames++) {
+            if (replaying)
+                replaying = movie.play_frame(emulator);
+            else if (rewinding && !recorder.recording())
+                rewind.step_back(emulator);
+            else {
+                rewind.capture(emulator);
+                recorder.record(keys);
+                emulator.run_frame();
+            }
+            next_frame += frame_period;
+        }
+        // Too far behind to catch up, drop the backlog rather than stall the UI
+        if (next_frame <= now)
+            next_frame = now + frame_period;
+    }
+    // Once per presented frame, however many frames ran
+    emulator.sync_display();
+}
+
+void Debugger::render() {
+    editor_target = &emulator;
+    highlight_profile = &profiler;
+    editor.DrawWindow("Memory", emulator.memory, MEM_SIZE);
+    editor.DrawWindow("Registers", emulator.register_file, 16);
+    editor.DrawWindow("Stack", emulator.stack, sizeof(emulator.stack));
+    {
+        if (ImGui::Begin("Special Registers")) {
+            if (ImGui::BeginTable("reg", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_Reorderable)) {
+                ImGui::TableSetupColumn("i_register");
+                ImGui::TableSetupColumn("program_counter");
+                ImGui::TableSetupColumn("next_instruction");
+                ImGui::TableSetupColumn("stack_pointer");
+                ImGui::TableSetupColumn("delay_timer");
+                ImGui::TableSetupColumn("sound_timer");
+                ImGui::TableHeadersRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%04x", emulator.i_register);
+                ImGui::TableNextColumn();
+                ImGui::Text("%04x", emulator.program_counter);
+                Instruction in;
+                emulator.get_instruction(in);
+                ImGui::TableNextColumn();
+                ImGui::Text("%04x", in.get_all());
+                ImGui::TableNextColumn();
+                ImGui::Text("%02x", emulator.stack_pointer);
+                ImGui::TableNextColumn();
+                ImGui::Text("%04x", emulator.delay_timer);
+                ImGui::TableNextColumn();
+                ImGui::Text("%04x", emulator.sound_timer);
+                ImGui::EndTable();
+            }
+        }
+        ImGui::End();
+    }
+    {
+        if (ImGui::Begin("Hotspots")) {
+            // Profiled frames run on the interpreter whatever the engine
+            if (ImGui::Button(profiling ? "Stop profiling" : "Profile")) {
+                profiling = !profiling;
+                emulator.set_profiler(profiling ? &profiler : nullptr);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset"))
+                profiler.clear();
+            uint64_t total = profiler.total_executions();
+            ImGui::SameLine();
+            ImGui::Text("%llu instructions", (unsigned long long)total);
+
+            profiler.hotspots(HOTSPOT_ROWS, hotspots);
+            highlight_threshold = hotspots.empty() ? 0 : hotspots.back().executions;
+            if (ImGui::BeginTable("hotspots", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("address");
+                ImGui::TableSetupColumn("executions");
+                ImGui::TableSetupColumn("share");
+                ImGui::TableSetupColumn("instruction");
+                ImGui::TableHeadersRow();
+                for (const Hotspot& hotspot : hotspots) {
+                    ImGui::TableNextColumn();
+                    char label[8];
+                    snprintf(label, sizeof(label), "%04x", hotspot.address);
+                    // Shows the instruction in the memory editor
+                    if (ImGui::Selectable(label, false, ImGuiSelectableFlags_SpanAllColumns))
+                        editor.GotoAddrAndHighlight(hotspot.address, hotspot.address + 2);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long)hotspot.executions);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f%%", 100.0 * hotspot.executions / total);
+                    ImGui::TableNextColumn();
+                    uint16_t opcode = (emulator.memory[hotspot.address] << 8) | emulator.memory[(hotspot.address + 1) & 0xFFFF];
+                    ImGui::Text("%04x %s", opcode, op_kind_names[(int)decode_kind(opcode)]);
+                }
+                ImGui::EndTable();
+            }
+            if (ImGui::BeginTable("kinds", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("kind");
+                ImGui::TableSetupColumn("executions");
+                ImGui::TableSetupColumn("host ns each");
+                ImGui::TableHeadersRow();
+                for (int kind = 0; kind < (int)OpKind::Count; kind++) {
+                    uint64_t count = profiler.kind_executions[kind];
+                    if (!count)
+                        continue;
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", op_kind_names[kind]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long)count);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f", profiler.kind_ns((OpKind)kind));
+                }
+                ImGui::EndTable();
+            }
+        }
+        else
+            highlight_threshold = 0;
+        ImGui::End();
+    }
+    {
+        if (ImGui::BeginMainMenuBar()) {
+            if (ImGui::BeginMenu("File")) {
+                if (ImGui::MenuItem("Open File")) {
+                    file_dialog.Open();
+                }
+                ImGui::EndMenu();
+            }
+            ImGui::EndMainMenuBar();
+        }
+        file_dialog.Display();
+        if (file_dialog.HasSelected()) {
+            recorder.stop();
+            replaying = false;
+            emulator.load_file(file_dialog.GetSelected().string().c_str());
+            rewind.clear();
+            profiler.clear();
+            file_dialog.ClearSelected();
+        }
+    }
+    {
+        ImGui::Begin("Interpreter Controls");
+        if (ImGui::Button("Pause")) {
+            emulator.set_paused(true);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Resume")) {
+            emulator.set_paused(false);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Step")) {
+            step_once = true;
+        }
+        ImGui::SameLine();
+        // Rewinds for as long as it is held
+        ImGui::Button("Rewind");
+        rewinding = ImGui::IsItemActive();
+        ImGui::SameLine();
+        if (ImGui::Button("Palate")) {
+            ImGui::OpenPopup("palate_picker");
+        }
+        if (ImGui::BeginPopup("palate_picker")) {
+            if (ImGui::Button("Apply")) {
+                for (int i = 0; i < 4; i++) {
+                    emulator.palate[i].r = (uint8_t)(color_select[i][0] * 255);
+                    emulator.palate[i].g = (uint8_t)(color_select[i][1] * 255);
+                    emulator.palate[i].b = (uint8_t)(color_select[i][2] * 255);
+                    emulator.palate[i].a = 255;
+                }
+                emulator.invalidate_display();
+            }
+            for (int i = 0; i < 4; i++) {
+                ImGui::ColorPicker3((std::string("Palate: ") + std::to_string(i)).c_str(), color_select[i], ImGuiColorEditFlags_PickerHueWheel | ImGuiColorEditFlags_NoInputs);
+                ImGui::SameLine();
+            }
+            ImGui::EndPopup();
+        }
+        // A movie runs at the speed it was recorded with
+        if (!recorder.recording() && !replaying) {
+            ImGui::SameLine();
+            if (ImGui::Button("Speed")) {
+                ImGui::OpenPopup("Speed Selector");
+            }
+        }
+        if (ImGui::BeginPopup("Speed Selector")) {
+            const uint32_t min_cycles = 1;
+            const uint32_t max_cycles = MAX_CYCLES_PER_FRAME;
+            ImGui::DragScalar("Cycles per frame", ImGuiDataType_U32, &emulator.cycles_per_frame, 1.0f, &min_cycles, &max_cycles);
+            ImGui::EndPopup();
+        }
+        int engine_index = (int)emulator.get_engine();
+        // AOT interprets while there is no module for the loaded ROM
+        if (ImGui::Combo("Engine", &engine_index, "Interpreter\0Block Cache\0JIT\0AOT\0Threaded\0"))
+            emulator.set_engine((Engine)engine_index);
+        ImGui::InputText("Movie", movie_path, sizeof(movie_path));
+        if (recorder.recording()) {
+            if (ImGui::Button("Stop recording"))
+                recorder.stop();
+            ImGui::SameLine();
+            ImGui::Text("%llu frames", (unsigned long long)recorder.frames());
+        }
+        else if (replaying) {
+            if (ImGui::Button("Stop replay"))
+                replaying = false;
+            ImGui::SameLine();
+            ImGui::Text("%llu frames", (unsigned long long)movie.frames());
+        }
+        else {
+            if (ImGui::Button("Record"))
+                recorder.start(movie_path, emulator);
+            ImGui::SameLine();
+            if (ImGui::Button("Replay") && movie.load(movie_path)) {
+                movie.start(emulator);
+                rewind.clear();
+                replaying = true;
+            }
+        }
+#if CHIP8_TRACE
+        // Traced frames run on the interpreter whatever the engine
+        ImGui::InputText("Trace", trace_path, sizeof(trace_path));
+        if (tracer.running()) {
+            if (ImGui::Button("Stop trace")) {
+                emulator.set_tracer(nullptr);
+                tracer.stop();
+            }
+            ImGui::SameLine();
+            ImGui::Text("%llu dropped", (unsigned long long)tracer.dropped_count());
+        }
+        else if (ImGui::Button("Trace") && tracer.start(trace_path)) {
+            emulator.set_tracer(&tracer);
+        }
+#endif
+        ImGui::Text("Rewind history: %.1f s, %.1f of %.0f MB", rewind.frames() / (float)FRAME_RATE, rewind.used() / 1048576.0f, rewind.capacity() / 1048576.0f);
+        ImGui::Text("Display kernel: %s", select_expand_planes().name);
+        ImGui::Text("Scroll kernel: %s", select_scroll().name);
+        ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        ImGui::End();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "Emulator.h"
+#include "Rewind.h"
+#include "Movie.h"
+#include "imgui.h"
+#include "imgui_memory_editor.h"
+#include "imfilebrowser.h"
+
+#include <cstdint>
+#include <vector>
+
+#define MAX_CATCHUP_FRAMES 4
+#define HOTSPOT_ROWS 32
+
+const ImGuiKey key_map[] = {
+    ImGuiKey_X,
+    ImGuiKey_1,
+    ImGuiKey_2,
+    ImGuiKey_3,
+    ImGuiKey_Q,
+    ImGuiKey_W,
+    ImGuiKey_E,
+    ImGuiKey_A,
+    ImGuiKey_S,
+    ImGuiKey_D,
+    ImGuiKey_Z,
+    ImGuiKey_C,
+    ImGuiKey_4,
+    ImGuiKey_R,
+    ImGuiKey_F,
+    ImGuiKey_V
+};
+
+// ImGui frontend for an Emulator: feeds it keys and 60Hz frames from the SDL clock and draws the
+// memory, register and control windows. The Emulator itself knows nothing about ImGui or SDL.
+class Debugger
+{
+private:
+    Emulator& emulator;
+    bool step_once = false;
+    bool rewinding = false;             // Rewind button held, frames play backwards
+    Rewind rewind;
+    MovieRecorder recorder;
+    Movie movie;
+    bool replaying = false;             // Frames and keys come from movie
+    char movie_path[256] = "session.c8m";
+#if CHIP8_TRACE
+    Tracer tracer;
+    char trace_path[256] = "session.c8t";
+#endif
+    Profiler profiler;
+    bool profiling = false;
+    std::vector<Hotspot> hotspots;      // Refreshed every rendered frame while the Hotspots window is open
+    uint64_t next_frame = 0;            // SDL performance counter value the next frame is due at
+    float color_select[4][3];
+    MemoryEditor editor;
+    ImGui::FileBrowser file_dialog{ImGuiFileBrowserFlags_NoModal};
+
+    static void editor_write(ImU8* data, size_t offset, ImU8 value);
+    static bool editor_highlight(const ImU8* data, size_t offset);
+    uint16_t read_keys();
+public:
+    Debugger(Emulator& emulator);
+    void tick();
+    void render();
+};
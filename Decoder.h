@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdint>
+
+class Emulator;
+struct Op;
+typedef void (*OpHandler)(Emulator& emu, const Op& op);
+
+// A predecoded instruction: the handler to run plus every operand already extracted
+struct Op {
+    OpHandler handler;
+    uint16_t opcode;
+    uint16_t NNN;
+    uint8_t X;
+    uint8_t Y;
+    uint8_t N;
+    uint8_t NN;
+};
+
+enum class OpKind : uint8_t {
+    Unknown,
+    Nop,
+    ScrollDown,     // 00CN
+    ScrollUp,       // 00DN
+    Clear,          // 00E0
+    Return,         // 00EE
+    ScrollRight,    // 00FB
+    ScrollLeft,     // 00FC
+    Exit,           // 00FD
+    LowRes,         // 00FE
+    HighRes,        // 00FF
+    Jump,           // 1NNN
+    Call,           // 2NNN
+    SkipEqImm,      // 3XNN
+    SkipNeImm,      // 4XNN
+    SkipEqReg,      // 5XY0
+    SaveRange,      // 5XY2
+    LoadRange,      // 5XY3
+    LoadImm,        // 6XNN
+    AddImm,         // 7XNN
+    Move,           // 8XY0
+    Or,             // 8XY1
+    And,            // 8XY2
+    Xor,            // 8XY3
+    AddReg,         // 8XY4
+    SubReg,         // 8XY5
+    ShiftRight,     // 8XY6
+    SubnReg,        // 8XY7
+    ShiftLeft,      // 8XYE
+    SkipNeReg,      // 9XY0
+    LoadI,          // ANNN
+    JumpV0,         // BNNN
+    Random,         // CXNN
+    Draw,           // DXYN
+    SkipKey,        // EX9E
+    SkipNotKey,     // EXA1
+    LoadLongI,      // F000 NNNN
+    Plane,          // FN01
+    GetDelay,       // FX07
+    WaitKey,        // FX0A
+    SetDelay,       // FX15
+    SetSound,       // FX18
+    AddI,           // FX1E
+    FontI,          // FX29
+    BigFontI,       // FX30
+    Bcd,            // FX33
+    Store,          // FX55
+    Load,           // FX65
+    SaveFlags,      // FX75
+    LoadFlags,      // FX85
+    Count
+};
+
+// Printable OpKind names, for tools
+constexpr const char* op_kind_names[(int)OpKind::Count] = {
+    "Unknown", "Nop", "ScrollDown", "ScrollUp", "Clear", "Return", "ScrollRight", "ScrollLeft", "Exit",
+    "LowRes", "HighRes", "Jump", "Call", "SkipEqImm", "SkipNeImm", "SkipEqReg", "SaveRange", "LoadRange",
+    "LoadImm", "AddImm", "Move", "Or", "And", "Xor", "AddReg", "SubReg", "ShiftRight", "SubnReg", "ShiftLeft",
+    "SkipNeReg", "LoadI", "JumpV0", "Random", "Draw", "SkipKey", "SkipNotKey", "LoadLongI", "Plane",
+    "GetDelay", "WaitKey", "SetDelay", "SetSound", "AddI", "FontI", "BigFontI", "Bcd", "Store", "Load",
+    "SaveFlags", "LoadFlags"
+};
+
+constexpr OpKind decode_kind(uint16_t opcode) {
+    uint8_t N = opcode & 0x000F;
+    uint8_t NN = opcode & 0x00FF;
+    switch (opcode >> 12) {
+    case 0x00:
+        if ((opcode & 0xFFF0) == 0x00C0) return OpKind::ScrollDown;
+        if ((opcode & 0xFFF0) == 0x00D0) return OpKind::ScrollUp;
+        switch (opcode) {
+        case 0x00E0: return OpKind::Clear;
+        case 0x00EE: return OpKind::Return;
+        case 0x00FB: return OpKind::ScrollRight;
+        case 0x00FC: return OpKind::ScrollLeft;
+        case 0x00FD: return OpKind::Exit;
+        case 0x00FE: return OpKind::LowRes;
+        case 0x00FF: return OpKind::HighRes;
+        default: return OpKind::Unknown;
+        }
+    case 0x01: return OpKind::Jump;
+    case 0x02: return OpKind::Call;
+    case 0x03: return OpKind::SkipEqImm;
+    case 0x04: return OpKind::SkipNeImm;
+    case 0x05:
+        switch (N) {
+        case 0x00: return OpKind::SkipEqReg;
+        case 0x02: return OpKind::SaveRange;
+        case 0x03: return OpKind::LoadRange;
+        default: return OpKind::Unknown;
+        }
+    case 0x06: return OpKind::LoadImm;
+    case 0x07: return OpKind::AddImm;
+    case 0x08:
+        switch (N) {
+        case 0x00: return OpKind::Move;
+        case 0x01: return OpKind::Or;
+        case 0x02: return OpKind::And;
+        case 0x03: return OpKind::Xor;
+        case 0x04: return OpKind::AddReg;
+        case 0x05: return OpKind::SubReg;
+        case 0x06: return OpKind::ShiftRight;
+        case 0x07: return OpKind::SubnReg;
+        case 0x0E: return OpKind::ShiftLeft;
+        default: return OpKind::Unknown;
+        }
+    case 0x09: return N == 0x00 ? OpKind::SkipNeReg : OpKind::Unknown;
+    case 0x0A: return OpKind::LoadI;
+    case 0x0B: return OpKind::JumpV0;
+    case 0x0C: return OpKind::Random;
+    case 0x0D: return OpKind::Draw;
+    case 0x0E:
+        switch (NN) {
+        case 0x9E: return OpKind::SkipKey;
+        case 0xA1: return OpKind::SkipNotKey;
+        default: return OpKind::Unknown;
+        }
+    default:
+        switch (NN) {
+        case 0x00: return opcode == 0xF000 ? OpKind::LoadLongI : OpKind::Nop;
+        case 0x01: return OpKind::Plane;
+        case 0x07: return OpKind::GetDelay;
+        case 0x0A: return OpKind::WaitKey;
+        case 0x15: return OpKind::SetDelay;
+        case 0x18: return OpKind::SetSound;
+        case 0x1E: return OpKind::AddI;
+        case 0x29: return OpKind::FontI;
+        case 0x30: return OpKind::BigFontI;
+        case 0x33: return OpKind::Bcd;
+        case 0x55: return OpKind::Store;
+        case 0x65: return OpKind::Load;
+        case 0x75: return OpKind::SaveFlags;
+        case 0x85: return OpKind::LoadFlags;
+        default: return OpKind::Unknown;
+        }
+    }
+}
+
+constexpr Op decode_operands(uint16_t opcode, OpHandler handler) {
+    Op op{};
+    op.handler = handler;
+    op.opcode = opcode;
+    op.NNN = opcode & 0x0FFF;
+    op.X = (opcode >> 8) & 0x000F;
+    op.Y = (opcode >> 4) & 0x000F;
+    op.N = opcode & 0x000F;
+    op.NN = opcode & 0x00FF;
+    // DXY0 draws a 16x16 sprite
+    if (decode_kind(opcode) == OpKind::Draw && op.N == 0)
+        op.N = 16;
+    return op;
+}
@@ -0,0 +1,259 @@
+#include "DisplayKernels.h"
+
+#include <cstring>
+
+#if KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC compiles any intrinsic regardless of the target flags
+#define TARGET_SSE2
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static_assert(sizeof(Color) == 4, "The kernels store a Color as one 32 bit lane");
+
+void expand_planes_scalar(const uint64_t* plane0, const uint64_t* plane1, const Color palette[4], Color* out, size_t words) {
+    for (size_t i = 0; i < words; i++) {
+        for (int j = 0; j < 64; j++) {
+            uint8_t index = (uint8_t)((((plane1[i] >> (63 - j)) & 0x01) << 1) | ((plane0[i] >> (63 - j)) & 0x01));
+            out[i * 64 + j] = palette[index];
+        }
+    }
+}
+
+void scroll_rows_left_scalar(uint64_t* rows, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t* words = rows + i * 2;
+        words[0] = (words[0] << 4) | (words[1] >> 60);
+        words[1] = words[1] << 4;
+    }
+}
+
+void scroll_rows_right_scalar(uint64_t* rows, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t* words = rows + i * 2;
+        words[1] = (words[1] >> 4) | (words[0] << 60);
+        words[0] = words[0] >> 4;
+    }
+}
+
+#if KERNELS_X86
+// A row loads as lane 0 = left word, lane 1 = right word. The nibble crossing between the two words is
+// shifted separately and moved over one lane with a byte shift.
+TARGET_SSE2 static inline __m128i scroll_row_left(__m128i row) {
+    __m128i carry = _mm_srli_si128(_mm_srli_epi64(row, 60), 8);
+    return _mm_or_si128(_mm_slli_epi64(row, 4), carry);
+}
+
+TARGET_SSE2 static inline __m128i scroll_row_right(__m128i row) {
+    __m128i carry = _mm_slli_si128(_mm_slli_epi64(row, 60), 8);
+    return _mm_or_si128(_mm_srli_epi64(row, 4), carry);
+}
+
+TARGET_SSE2 void scroll_rows_left_sse2(uint64_t* rows, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        __m128i* row = (__m128i*)(rows + i * 2);
+        _mm_storeu_si128(row, scroll_row_left(_mm_loadu_si128(row)));
+    }
+}
+
+TARGET_SSE2 void scroll_rows_right_sse2(uint64_t* rows, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        __m128i* row = (__m128i*)(rows + i * 2);
+        _mm_storeu_si128(row, scroll_row_right(_mm_loadu_si128(row)));
+    }
+}
+
+// Two rows per register, the byte shifts work within each 128 bit lane so rows never mix
+TARGET_AVX2 void scroll_rows_left_avx2(uint64_t* rows, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256i* pair = (__m256i*)(rows + i * 2);
+        __m256i row = _mm256_loadu_si256(pair);
+        __m256i carry = _mm256_srli_si256(_mm256_srli_epi64(row, 60), 8);
+        _mm256_storeu_si256(pair, _mm256_or_si256(_mm256_slli_epi64(row, 4), carry));
+    }
+    if (i < count)
+        scroll_rows_left_sse2(rows + i * 2, 1);
+}
+
+TARGET_AVX2 void scroll_rows_right_avx2(uint64_t* rows, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256i* pair = (__m256i*)(rows + i * 2);
+        __m256i row = _mm256_loadu_si256(pair);
+        __m256i carry = _mm256_slli_si256(_mm256_slli_epi64(row, 60), 8);
+        _mm256_storeu_si256(pair, _mm256_or_si256(_mm256_srli_epi64(row, 4), carry));
+    }
+    if (i < count)
+        scroll_rows_right_sse2(rows + i * 2, 1);
+}
+
+// 16 pixels at a time. Their palette indices are built as one byte each, premultiplied by 4, and the
+// palette is exactly one register of 16 bytes, so a pshufb that repeats each index over 4 bytes plus the
+// byte within the color looks up 4 whole RGBA pixels.
+TARGET_SSE41 void expand_planes_sse41(const uint64_t* plane0, const uint64_t* plane1, const Color palette[4], Color* out, size_t words) {
+    const __m128i table = _mm_loadu_si128((const __m128i*)palette);
+    // Pixel j of a byte is bit 7 - j
+    const __m128i bit_masks = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+        (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m128i plane0_index = _mm_set1_epi8(4);
+    const __m128i plane1_index = _mm_set1_epi8(8);
+    const __m128i channels = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+    // Bytes 0-7 of the register hold the plane 0 word, bytes 8-15 plane 1. The leftmost pixels are in the
+    // most significant byte, so group q of 16 pixels spreads bytes 7 - 2q and 6 - 2q over 8 lanes each.
+    __m128i spread0[4], spread1[4];
+    for (int q = 0; q < 4; q++) {
+        char high = (char)(7 - 2 * q), low = (char)(6 - 2 * q);
+        spread0[q] = _mm_setr_epi8(high, high, high, high, high, high, high, high, low, low, low, low, low, low, low, low);
+        spread1[q] = _mm_add_epi8(spread0[q], _mm_set1_epi8(8));
+    }
+    // Pixel p of a group of 4 takes its index byte into all 4 bytes of its color
+    __m128i repeat[4];
+    for (int g = 0; g < 4; g++) {
+        char p0 = (char)(4 * g), p1 = (char)(4 * g + 1), p2 = (char)(4 * g + 2), p3 = (char)(4 * g + 3);
+        repeat[g] = _mm_setr_epi8(p0, p0, p0, p0, p1, p1, p1, p1, p2, p2, p2, p2, p3, p3, p3, p3);
+    }
+    for (size_t i = 0; i < words; i++) {
+        __m128i bits = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(plane0 + i)),
+            _mm_loadl_epi64((const __m128i*)(plane1 + i)));
+        for (int q = 0; q < 4; q++) {
+            __m128i set0 = _mm_cmpeq_epi8(_mm_and_si128(_mm_shuffle_epi8(bits, spread0[q]), bit_masks), bit_masks);
+            __m128i set1 = _mm_cmpeq_epi8(_mm_and_si128(_mm_shuffle_epi8(bits, spread1[q]), bit_masks), bit_masks);
+            __m128i index = _mm_or_si128(_mm_and_si128(set0, plane0_index), _mm_and_si128(set1, plane1_index));
+            Color* pixels = out + i * 64 + q * 16;
+            for (int g = 0; g < 4; g++) {
+                __m128i bytes = _mm_or_si128(_mm_shuffle_epi8(index, repeat[g]), channels);
+                _mm_storeu_si128((__m128i*)(pixels + g * 4), _mm_shuffle_epi8(table, bytes));
+            }
+        }
+    }
+}
+
+TARGET_AVX2 void expand_planes_avx2(const uint64_t* plane0, const uint64_t* plane1, const Color palette[4], Color* out, size_t words) {
+    uint32_t colors[4];
+    memcpy(colors, palette, sizeof(colors));
+    // Lanes 4-7 repeat the palette so the permute below only ever sees indices 0-3
+    const __m256i table = _mm256_setr_epi32((int)colors[0], (int)colors[1], (int)colors[2], (int)colors[3],
+        (int)colors[0], (int)colors[1], (int)colors[2], (int)colors[3]);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    // One mask per byte of a 32 bit half word, most significant bit first
+    __m256i masks[4];
+    for (int k = 0; k < 4; k++) {
+        int shift = 24 - k * 8;
+        masks[k] = _mm256_setr_epi32((int)(0x80u << shift), (int)(0x40u << shift), (int)(0x20u << shift), (int)(0x10u << shift),
+            (int)(0x08u << shift), (int)(0x04u << shift), (int)(0x02u << shift), (int)(0x01u << shift));
+    }
+    for (size_t i = 0; i < words; i++) {
+        for (int half = 0; half < 2; half++) {
+            __m256i bits0 = _mm256_set1_epi32((int)(uint32_t)(plane0[i] >> (32 - half * 32)));
+            __m256i bits1 = _mm256_set1_epi32((int)(uint32_t)(plane1[i] >> (32 - half * 32)));
+            Color* pixels = out + i * 64 + half * 32;
+            for (int k = 0; k < 4; k++) {
+                __m256i set0 = _mm256_cmpeq_epi32(_mm256_and_si256(bits0, masks[k]), masks[k]);
+                __m256i set1 = _mm256_cmpeq_epi32(_mm256_and_si256(bits1, masks[k]), masks[k]);
+                __m256i index = _mm256_or_si256(_mm256_and_si256(set0, one), _mm256_and_si256(set1, two));
+                _mm256_storeu_si256((__m256i*)(pixels + k * 8), _mm256_permutevar8x32_epi32(table, index));
+            }
+        }
+    }
+}
+#endif
+
+bool cpu_has_sse2() {
+#if !KERNELS_X86
+    return false;
+#elif defined(_M_X64) || defined(__x86_64__)
+    // Part of the x86-64 baseline
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] >> 26) & 1;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool cpu_has_sse41() {
+#if !KERNELS_X86
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] >> 19) & 1;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+bool cpu_has_avx2() {
+#if !KERNELS_X86
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    // The OS must save the YMM registers too
+    bool os_saves_ymm = ((info[2] >> 27) & 1) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuid(info, 0);
+    if (!os_saves_ymm || info[0] < 7)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] >> 5) & 1;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+size_t available_expand_planes(ExpandPlanesKernel* kernels, size_t capacity) {
+    size_t count = 0;
+    if (count < capacity)
+        kernels[count++] = { "scalar", &expand_planes_scalar };
+#if KERNELS_X86
+    if (count < capacity && cpu_has_sse41())
+        kernels[count++] = { "sse4.1", &expand_planes_sse41 };
+    if (count < capacity && cpu_has_avx2())
+        kernels[count++] = { "avx2", &expand_planes_avx2 };
+#endif
+    return count;
+}
+
+const ExpandPlanesKernel& select_expand_planes() {
+    static const ExpandPlanesKernel best = [] {
+        ExpandPlanesKernel kernels[4];
+        size_t count = available_expand_planes(kernels, 4);
+        return kernels[count - 1];
+    }();
+    return best;
+}
+
+size_t available_scroll(ScrollKernel* kernels, size_t capacity) {
+    size_t count = 0;
+    if (count < capacity)
+        kernels[count++] = { "scalar", &scroll_rows_left_scalar, &scroll_rows_right_scalar };
+#if KERNELS_X86
+    if (count < capacity && cpu_has_sse2())
+        kernels[count++] = { "sse2", &scroll_rows_left_sse2, &scroll_rows_right_sse2 };
+    if (count < capacity && cpu_has_avx2())
+        kernels[count++] = { "avx2", &scroll_rows_left_avx2, &scroll_rows_right_avx2 };
+#endif
+    return count;
+}
+
+const ScrollKernel& select_scroll() {
+    static const ScrollKernel best = [] {
+        ScrollKernel kernels[4];
+        size_t count = available_scroll(kernels, 4);
+        return kernels[count - 1];
+    }();
+    return best;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "Color.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define KERNELS_X86 1
+#else
+#define KERNELS_X86 0
+#endif
+
+// Expands `words` 64 bit words of the two bitplanes into 64 * words display pixels. Each pixel takes the
+// palette entry (plane1 bit << 1) | plane0 bit, most significant bit first.
+typedef void (*ExpandPlanesFn)(const uint64_t* plane0, const uint64_t* plane1, const Color palette[4], Color* out, size_t words);
+
+struct ExpandPlanesKernel {
+    const char* name;
+    ExpandPlanesFn function;
+};
+
+void expand_planes_scalar(const uint64_t* plane0, const uint64_t* plane1, const Color palette[4], Color* out, size_t words);
+#if KERNELS_X86
+void expand_planes_sse41(const uint64_t* plane0, const uint64_t* plane1, const Color palette[4], Color* out, size_t words);
+void expand_planes_avx2(const uint64_t* plane0, const uint64_t* plane1, const Color palette[4], Color* out, size_t words);
+#endif
+
+// Scrolls `rows` display rows of two words (128 pixels) 4 pixels left or right, shifting in blank pixels.
+// Rows are independent, so both bitplanes can be passed as one run.
+typedef void (*ScrollRowsFn)(uint64_t* rows, size_t count);
+
+struct ScrollKernel {
+    const char* name;
+    ScrollRowsFn left;
+    ScrollRowsFn right;
+};
+
+void scroll_rows_left_scalar(uint64_t* rows, size_t count);
+void scroll_rows_right_scalar(uint64_t* rows, size_t count);
+#if KERNELS_X86
+void scroll_rows_left_sse2(uint64_t* rows, size_t count);
+void scroll_rows_right_sse2(uint64_t* rows, size_t count);
+void scroll_rows_left_avx2(uint64_t* rows, size_t count);
+void scroll_rows_right_avx2(uint64_t* rows, size_t count);
+#endif
+
+bool cpu_has_sse2();
+bool cpu_has_sse41();
+bool cpu_has_avx2();
+// The fastest kernel this CPU supports, checked once
+const ExpandPlanesKernel& select_expand_planes();
+// Every kernel this CPU can run, scalar first. Returns the count.
+size_t available_expand_planes(ExpandPlanesKernel* kernels, size_t capacity);
+const ScrollKernel& select_scroll();
+size_t available_scroll(ScrollKernel* kernels, size_t capacity);
@@ -1,63 +1,201 @@
 #include "Emulator.h"
-#include "vk_types.h"
-#include <SDL.h>
-#include <imgui.h>
+#include "Hash.h"
+#include "RomPack.h"
 
 #include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
+#include <vector>
 
 Emulator::Emulator(Color display[]) {
     this->display = display;
-    this->time = (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
-    this->memory = new uint8_t[MEM_SIZE];
-    editor.Cols = 8;
-    editor.OptShowAscii = false;
-
-    load_file("./roms/octojam1title.ch8");
+    this->expand_planes = select_expand_planes().function;
+    this->scroll = select_scroll();
+    aot_state.memory = memory;
+    aot_state.registers = register_file;
+    aot_state.stack = stack;
+    aot_state.program_counter = &program_counter;
+    aot_state.i_register = &i_register;
+    aot_state.stack_pointer = &stack_pointer;
+    aot_state.emulator = this;
+    aot_state.execute = &Emulator::aot_execute;
 
+    load_rom(nullptr, 0);
 }
 
-Emulator::~Emulator() {
-    delete[] this->memory;
+void Emulator::scroll_planes(bool left) {
+    ScrollRowsFn kernel = left ? scroll.left : scroll.right;
+    if (lores_native) {
+        // 4 high resolution pixels are 2 low resolution ones
+        for (uint8_t map_index = 0; map_index < 2; map_index++) {
+            if (color_plane & (1 << map_index)) {
+                for (uint64_t& bits : lores_bitmap[map_index])
+                    bits = left ? bits << 2 : bits >> 2;
+            }
+        }
+    }
+    // The planes are adjacent in display_bitmap, so scrolling both is one run of 128 rows
+    else if (color_plane == 3)
+        kernel(display_bitmap[0][0], 128);
+    else if (color_plane != 0)
+        kernel(display_bitmap[color_plane - 1][0], 64);
+    dirty_rows = ALL_ROWS_DIRTY;
 }
 
 void Emulator::clear_screen() {
     for (uint8_t i = 0; i < 2; i++) {
         memset(display_bitmap[i], 0, sizeof(display_bitmap[i]));
+        memset(lores_bitmap[i], 0, sizeof(lores_bitmap[i]));
+        row_base[i] = 0;
+    }
+    lores_native = !high_resolution;
+    dirty_rows = ALL_ROWS_DIRTY;
+}
+
+void Emulator::lores_to_hires() {
+    for (uint8_t map_index = 0; map_index < 2; map_index++) {
+        uint64_t rows[32];
+        for (uint8_t row = 0; row < 32; row++) {
+            rows[row] = *lores_row(map_index, row);
+        }
+        for (uint8_t row = 0; row < 32; row++) {
+            uint64_t* words = display_bitmap[map_index][row * 2];
+            words[0] = double_pixels((uint32_t)(rows[row] >> 32));
+            words[1] = double_pixels((uint32_t)rows[row]);
+            memcpy(display_bitmap[map_index][row * 2 + 1], words, DISPLAY_ROW_WORDS * sizeof(uint64_t));
+        }
+        row_base[map_index] = 0;
     }
-    sync_display();
+    lores_native = false;
+}
+
+bool Emulator::hires_to_lores() {
+    for (uint8_t map_index = 0; map_index < 2; map_index++) {
+        for (uint8_t row = 0; row < 64; row += 2) {
+            const uint64_t* top = plane_row(map_index, row);
+            const uint64_t* bottom = plane_row(map_index, row + 1);
+            for (int word = 0; word < DISPLAY_ROW_WORDS; word++) {
+                // Both rows of a pair equal, and both bits of every horizontal pair equal
+                if (top[word] != bottom[word] || ((top[word] ^ (top[word] >> 1)) & 0x5555555555555555ull))
+                    return false;
+            }
+        }
+    }
+    for (uint8_t map_index = 0; map_index < 2; map_index++) {
+        uint64_t rows[32];
+        for (uint8_t row = 0; row < 32; row++) {
+            const uint64_t* words = plane_row(map_index, row * 2);
+            rows[row] = ((uint64_t)halve_pixels(words[0]) << 32) | halve_pixels(words[1]);
+        }
+        memcpy(lores_bitmap[map_index], rows, sizeof(rows));
+        row_base[map_index] = 0;
+    }
+    lores_native = true;
+    return true;
 }
 
 void Emulator::load_file(const char* filename) {
+    // Mapped rather than read, the ROM is copied straight from the mapping into memory
+    MappedFile file;
+    if (!file.open(filename))
+        std::cout << "Can't read " << filename << std::endl;
+    load_rom(file.data(), (uint32_t)(file.size() < MAX_ROM_SIZE ? file.size() : MAX_ROM_SIZE));
+}
+
+void Emulator::load_rom(const uint8_t* data, uint32_t size) {
+    clear_caches();
+    instruction_count = 0;
+    unknown_opcode_count = 0;
     memset(memory, 0, MEM_SIZE);
     memset(stack, 0, sizeof(stack));
+    high_resolution = false;
     clear_screen();
     memcpy(memory, font_data, sizeof(font_data));
     color_plane = 1;
-    high_resolution = false;
 
-    std::streampos size;
-    std::ifstream file;
-    file.open(filename, std::ios::binary | std::ios::ate);
-    size = file.tellg() < 0xFF38 ? file.tellg() : (std::streampos)0xFF38;
-    file.seekg(0, std::ios::beg);
-    file.read((char*)this->memory + 0x200, size);
-    std::cout << "READ " << size << " bytes" << std::endl;
-    file.close();
+    rom_size = size < MAX_ROM_SIZE ? size : MAX_ROM_SIZE;
+    if (rom_size)
+        memcpy(memory + 0x200, data, rom_size);
+    rom_hash = fnv1a(memory + 0x200, rom_size);
+    load_aot();
 
     program_counter = 0x0200;
     i_register = 0x0000;
     delay_timer = 0;
     sound_timer = 0;
-    counter = 0;
     memset(register_file, 0, sizeof(register_file));
     memset(rpl_file, 0, sizeof(rpl_file));
+    random_state = random_seed;
+}
+
+void Emulator::clear_caches() {
+    block_cache.clear();
+    jit.reset(block_cache);
+    threaded_code.clear();
+    sprite_cache.clear();
+}
+
+void Emulator::load_aot() {
+    aot.load(rom_hash, rom_size);
+}
+
+void Emulator::copy_state(const Emulator& other) {
+    load_state(other);
 }
 
-void Emulator::set_keys() {
+void Emulator::load_state(const MachineState& state) {
+    bool same_rom = state.rom_hash == rom_hash && state.rom_size == rom_size;
+    bool same_memory = memcmp(memory, state.memory, MEM_SIZE) == 0;
+    if (!same_memory && same_rom && aot.loaded()) {
+        // The module stays usable as long as the code it was compiled from is unchanged
+        for (uint32_t address = 0; address < MEM_SIZE && !aot.invalidated; address++) {
+            if (memory[address] != state.memory[address] && aot.is_code(address))
+                aot.invalidated = true;
+        }
+    }
+    MachineState::operator=(state);
+    dirty_rows = ALL_ROWS_DIRTY;
+
+    if (!same_memory)
+        clear_caches();
+    if (!same_rom)
+        load_aot();
+    else if (aot.invalidated)
+        aot.unload();
+}
+
+void Emulator::read_row(uint8_t row, uint64_t* out) const {
+    for (uint8_t map_index = 0; map_index < 2; map_index++) {
+        uint64_t* words = out + (map_index * 64 + row) * DISPLAY_ROW_WORDS;
+        if (lores_native) {
+            uint64_t bits = lores_bitmap[map_index][(row / 2 + row_base[map_index]) % 32];
+            words[0] = double_pixels((uint32_t)(bits >> 32));
+            words[1] = double_pixels((uint32_t)bits);
+        }
+        else {
+            memcpy(words, display_bitmap[map_index][(row + row_base[map_index]) % 64], DISPLAY_ROW_WORDS * sizeof(uint64_t));
+        }
+    }
+}
+
+void Emulator::read_planes(uint64_t* out) const {
+    for (uint8_t row = 0; row < 64; row++) {
+        read_row(row, out);
+    }
+}
+
+void Emulator::read_changed_planes(uint64_t* out) {
+    for (uint8_t row = 0; dirty_rows; row++, dirty_rows >>= 1) {
+        if (dirty_rows & 1)
+            read_row(row, out);
+    }
+}
+
+void Emulator::set_keys(uint16_t mask) {
     for (int i = 0; i < 16; i++) {
-        keys[i] = ImGui::IsKeyDown(key_map[i]);
+        keys[i] = (mask >> i) & 0x01;
     }
 }
 
@@ -66,584 +204,914 @@ void Emulator::get_instruction(Instruction& in) {
 }
 
 void Emulator::sync_display() {
-    for (int i = 0; i < sizeof(display_bitmap[0]); i++) {
-        for (int j = 0; j < 8; j++) {
-            uint8_t bitmap = 0x00;
-            for (int k = 1; k >= 0; k--) {
-                bitmap <<= 1;
-                bitmap |= (display_bitmap[k][i] >> (7 - j)) & 0x01;
+    // Only the rows touched since the last call are converted, each run of adjacent dirty rows in one call
+    int row = 0;
+    while (dirty_rows) {
+        if (!(dirty_rows & 1)) {
+            dirty_rows >>= 1;
+            row++;
+            continue;
+        }
+        int first = row;
+        while (dirty_rows & 1) {
+            dirty_rows >>= 1;
+            row++;
+        }
+        if (lores_native) {
+            // Double the low resolution rows up to 128 pixels, then convert them like high resolution ones
+            uint64_t doubled[2][64][DISPLAY_ROW_WORDS];
+            for (int i = first; i < row; i++) {
+                for (uint8_t map_index = 0; map_index < 2; map_index++) {
+                    uint64_t bits = *lores_row(map_index, i / 2);
+                    doubled[map_index][i][0] = double_pixels((uint32_t)(bits >> 32));
+                    doubled[map_index][i][1] = double_pixels((uint32_t)bits);
+                }
             }
-            display[i * 8 + j] = palate[bitmap];
+            expand_planes(doubled[0][first], doubled[1][first], palate, display + first * 128, (row - first) * DISPLAY_ROW_WORDS);
+            continue;
+        }
+        // The planes scroll independently, split the run wherever either one wraps back to physical row 0
+        while (first < row) {
+            int row0 = (first + row_base[0]) % 64;
+            int row1 = (first + row_base[1]) % 64;
+            int count = std::min({ row - first, 64 - row0, 64 - row1 });
+            expand_planes(display_bitmap[0][row0], display_bitmap[1][row1], palate, display + first * 128, count * DISPLAY_ROW_WORDS);
+            first += count;
         }
     }
 }
 
-void Emulator::draw_array_to_display(uint8_t* byte_array, uint8_t x, uint8_t y, int width, int height, uint8_t map_index) {
+void Emulator::draw_rows(const uint64_t* rows, uint8_t x, uint8_t y, int height, uint8_t map_index) {
     uint8_t& VF = register_file[0xF];
-    uint8_t byte_offset = x / 8;
-    uint8_t bit_offset = x % 8;
     for (int i = 0; i < height; i++) {
-        uint16_t bitmap_offset = (y + i) % 64 * 16 + (byte_offset) % 16;
-        uint8_t data = byte_array[i * width] >> bit_offset;
-        display_bitmap[map_index][bitmap_offset] ^= data;
-        if (~display_bitmap[map_index][bitmap_offset] & data) VF = 1;
-        for (int j = 1; j < width; j++) {
-            bitmap_offset = (y + i) % 64 * 16 + (byte_offset + j) % 16;
-            data = byte_array[i * width + j - 1] << (8 - bit_offset) | byte_array[i * width + j] >> bit_offset;
-            display_bitmap[map_index][bitmap_offset] ^= data;
-            if (~display_bitmap[map_index][bitmap_offset] & data) VF = 1;
-        }
-        bitmap_offset = (y + i) % 64 * 16 + (byte_offset + width) % 16;
-        data = byte_array[i * width + width - 1] << (8 - bit_offset);
-        display_bitmap[map_index][bitmap_offset] ^= data;
-        if (~display_bitmap[map_index][bitmap_offset] & data) VF = 1;
+        // Sprite rows start at the left edge of a 128 pixel row, rotate them into place
+        uint64_t high = rows[i];
+        uint64_t low = 0;
+        rotate_right_128(high, low, x % 128);
+
+        uint8_t row = (y + i) % 64;
+        uint64_t* words = plane_row(map_index, row);
+        if ((words[0] & high) | (words[1] & low)) VF = 1;
+        words[0] ^= high;
+        words[1] ^= low;
+        dirty_rows |= 1ull << row;
     }
 }
 
-void Emulator::skip_next_instruction() {
-    program_counter += 2;
+void Emulator::draw_lores_rows(const uint64_t* rows, uint8_t x, uint8_t y, int height, uint8_t map_index) {
+    uint8_t& VF = register_file[0xF];
+    x %= 64;
+    for (int i = 0; i < height; i++) {
+        uint64_t bits = x ? (rows[i] >> x) | (rows[i] << (64 - x)) : rows[i];
+        uint8_t row = (y + i) % 32;
+        uint64_t* word = lores_row(map_index, row);
+        if (*word & bits) VF = 1;
+        *word ^= bits;
+        dirty_rows |= 3ull << (row * 2);
+    }
+}
 
+void Emulator::skip_next_instruction() {
     Instruction in;
     get_instruction(in);
     if (in.get_all() == 0xF000)
         program_counter += 2;
+    program_counter += 2;
+}
+
+constexpr std::array<Op, 0x10000> Emulator::build_decode_table() {
+    constexpr OpHandler handlers[] = {
+        &dispatch<&Emulator::op_unknown>,
+        &dispatch<&Emulator::op_nop>,
+        &dispatch<&Emulator::op_scroll_down>,
+        &dispatch<&Emulator::op_scroll_up>,
+        &dispatch<&Emulator::op_clear>,
+        &dispatch<&Emulator::op_return>,
+        &dispatch<&Emulator::op_scroll_right>,
+        &dispatch<&Emulator::op_scroll_left>,
+        &dispatch<&Emulator::op_exit>,
+        &dispatch<&Emulator::op_low_res>,
+        &dispatch<&Emulator::op_high_res>,
+        &dispatch<&Emulator::op_jump>,
+        &dispatch<&Emulator::op_call>,
+        &dispatch<&Emulator::op_skip_eq_imm>,
+        &dispatch<&Emulator::op_skip_ne_imm>,
+        &dispatch<&Emulator::op_skip_eq_reg>,
+        &dispatch<&Emulator::op_save_range>,
+        &dispatch<&Emulator::op_load_range>,
+        &dispatch<&Emulator::op_load_imm>,
+        &dispatch<&Emulator::op_add_imm>,
+        &dispatch<&Emulator::op_move>,
+        &dispatch<&Emulator::op_or>,
+        &dispatch<&Emulator::op_and>,
+        &dispatch<&Emulator::op_xor>,
+        &dispatch<&Emulator::op_add_reg>,
+        &dispatch<&Emulator::op_sub_reg>,
+        &dispatch<&Emulator::op_shift_right>,
+        &dispatch<&Emulator::op_subn_reg>,
+        &dispatch<&Emulator::op_shift_left>,
+        &dispatch<&Emulator::op_skip_ne_reg>,
+        &dispatch<&Emulator::op_load_i>,
+        &dispatch<&Emulator::op_jump_v0>,
+        &dispatch<&Emulator::op_random>,
+        &dispatch<&Emulator::op_draw>,
+        &dispatch<&Emulator::op_skip_key>,
+        &dispatch<&Emulator::op_skip_not_key>,
+        &dispatch<&Emulator::op_load_long_i>,
+        &dispatch<&Emulator::op_plane>,
+        &dispatch<&Emulator::op_get_delay>,
+        &dispatch<&Emulator::op_wait_key>,
+        &dispatch<&Emulator::op_set_delay>,
+        &dispatch<&Emulator::op_set_sound>,
+        &dispatch<&Emulator::op_add_i>,
+        &dispatch<&Emulator::op_font_i>,
+        &dispatch<&Emulator::op_big_font_i>,
+        &dispatch<&Emulator::op_bcd>,
+        &dispatch<&Emulator::op_store>,
+        &dispatch<&Emulator::op_load>,
+        &dispatch<&Emulator::op_save_flags>,
+        &dispatch<&Emulator::op_load_flags>
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == (size_t)OpKind::Count, "Missing opcode handler");
+
+    std::array<Op, 0x10000> table{};
+    for (uint32_t opcode = 0; opcode < 0x10000; opcode++) {
+        table[opcode] = decode_operands((uint16_t)opcode, handlers[(size_t)decode_kind((uint16_t)opcode)]);
+    }
+    return table;
 }
 
+constexpr std::array<Op, 0x10000> Emulator::decode_table = Emulator::build_decode_table();
+
 void Emulator::execute(Instruction& in) {
-    uint8_t X = in.get_high_low();
-    uint8_t Y = in.get_low_high();
-    uint8_t& VX = register_file[X];
-    uint8_t& VY = register_file[Y];
-    uint8_t N = in.get_low_low();
-    uint8_t NN = in.get_low();
-    uint16_t NNN = in.get_all() & 0x0FFF;
-    uint8_t& V0 = register_file[0x0];
-    uint8_t& VF = register_file[0xF];
-    switch (in.get_high_high()) {
-    case 0x00:
-        switch (in.get_low_high()) {
-        case 0x0C:
-            // Scroll display N lines down
-            for (uint8_t map_index = 0; map_index < 2; map_index++) {
-                if (color_plane & (1 << map_index)) {
-                    for (uint8_t i = 0; i < 16; i++) {
-                        for (uint8_t j = 63; j >= N; j--) {
-                            display_bitmap[map_index][j * 16 + i] = display_bitmap[map_index][(j - N) * 16 + i];
-                        }
-                    }
-                }
-            }
-            sync_display();
-            break;
-        case 0x0D:
-            // Scroll display N lines up
-            for (uint8_t map_index = 0; map_index < 2; map_index++) {
-                if (color_plane & (1 << map_index)) {
-                    for (uint8_t i = 0; i < 16; i++) {
-                        for (uint8_t j = 0; j < 64 - N; j++) {
-                            display_bitmap[map_index][j * 16 + i] = display_bitmap[map_index][(j + N) * 16 + i];
-                        }
-                    }
-                }
-            }
-            sync_display();
-        }
-        switch (in.get_all()) {
-        case 0x00E0:
-            // Clear the screen
-            clear_screen();
-            break;
-        case 0x00EE:
-            // 0x00EE Return from a subroutine
-            program_counter = stack[--stack_pointer];
-            break;
-        case 0x00FB:
-            // Scroll display 4 pixels right
-            for (uint8_t map_index = 0; map_index < 2; map_index++) {
-                if (color_plane & (1 << map_index)) {
-                    for (uint8_t j = 0; j < 64; j++) {
-                        for (uint8_t i = 15; i > 0; i--) {
-                            display_bitmap[map_index][j * 16 + i] = (display_bitmap[map_index][j * 16 + i - 1] << 4) | (display_bitmap[map_index][j * 16 + i] >> 4);
-                        }
-                        display_bitmap[map_index][j * 16] = display_bitmap[map_index][j * 16] >> 4;
-                    }
-                }
-            }
-            sync_display();
-            break;
-        case 0x00FC:
-            // Scroll display 4 pixels left
-            for (uint8_t map_index = 0; map_index < 2; map_index++) {
-                if (color_plane & (1 << map_index)) {
-                    for (uint8_t j = 0; j < 64; j++) {
-                        for (uint8_t i = 0; i < 15; i++) {
-                            display_bitmap[map_index][j * 16 + i] = (display_bitmap[map_index][j * 16 + i] << 4) | (display_bitmap[map_index][j * 16 + i + 1] >> 4);
-                        }
-                        display_bitmap[map_index][j * 16 + 15] = display_bitmap[map_index][j * 16 + 15] << 4;
-                    }
+    const Op& op = decode_table[in.get_all()];
+    program_counter += 2;
+    op.handler(*this, op);
+}
+
+void Emulator::op_unknown(const Op& op) {
+    // Only the first is printed, a ROM stuck on one would otherwise print thousands of lines a second.
+    // The rest are counted, a trace shows where they are.
+    if (unknown_opcode_count++ == 0)
+        std::cout << "Not implemented: " << std::hex << op.opcode << std::dec << std::endl;
+}
+
+void Emulator::op_nop(const Op&) {
+}
+
+void Emulator::op_scroll_down(const Op& op) {
+    // Scroll display N lines down, moving the row base and blanking the N rows scrolled in at the top
+    if (lores_native && !(op.N & 1)) {
+        for (uint8_t map_index = 0; map_index < 2; map_index++) {
+            if (color_plane & (1 << map_index)) {
+                row_base[map_index] = (row_base[map_index] - op.N / 2) % 32;
+                for (uint8_t j = 0; j < op.N / 2; j++) {
+                    *lores_row(map_index, j) = 0;
                 }
             }
-            sync_display();
-            break;
-        case 0x00FD:
-            // Exit CHIP interpreter
-            paused = true;
-            break;
-        case 0x00FE:
-            // Disable extended screen mode
-            high_resolution = false;
-            break;
-        case 0x00FF:
-            // Enable extended screen mode
-            high_resolution = true;
-            break;
-        default:
-            if (!(in.get_low_high() == 0x0C))
-                std::cout << "Not implemented: " << std::hex << in.get_all() << std::endl;
-        }
-        break;
-    case 0x01:
-        // Jump to NNN
-        program_counter = NNN;
-        return;
-    case 0x02:
-        // Call NNN
-        if (stack_pointer < sizeof(stack) / sizeof(stack[0])) {
-            stack[stack_pointer++] = program_counter;
-            program_counter = NNN;
         }
+        dirty_rows = ALL_ROWS_DIRTY;
         return;
-    case 0x03:
-        // Skip the following instruction if the value of register VX equals NN
-        if (VX == NN)
-            skip_next_instruction();
-
-        break;
-    case 0x04:
-        // Skip the following instruction if the value of register VX is not equal to NN
-        if (VX != NN)
-            skip_next_instruction();
-        break;
-    case 0x05:
-        switch (in.get_low_low()) {
-        case 0x00:
-            // Skip the following instruction if the value of register VX is equal to the value of register VY
-            if (VX == VY)
-                skip_next_instruction();
-            break;
-        case 0x02:
-            // Save an inclusive range of registers to memory starting at I
-            if (VY > VX && VX < 16 && VY < 16) {
-                for (uint8_t i = VX; i <= VY; i++) {
-                    memory[i_register + i] = register_file[i];
-                }
+    }
+    // Half a low resolution pixel can only be shown in high resolution
+    if (lores_native)
+        lores_to_hires();
+    for (uint8_t map_index = 0; map_index < 2; map_index++) {
+        if (color_plane & (1 << map_index)) {
+            row_base[map_index] = (row_base[map_index] - op.N) % 64;
+            for (uint8_t j = 0; j < op.N; j++) {
+                memset(plane_row(map_index, j), 0, DISPLAY_ROW_WORDS * sizeof(uint64_t));
             }
-            break;
-        case 0x03:
-            // Load an inclusive range of registers from memory starting at I
-            if (VY > VX && VX < 16 && VY < 16) {
-                for (uint8_t i = VX; i <= VY; i++) {
-                    register_file[i] = memory[i_register + i];
+        }
+    }
+    dirty_rows = ALL_ROWS_DIRTY;
+}
+
+void Emulator::op_scroll_up(const Op& op) {
+    // Scroll display N lines up, moving the row base and blanking the N rows scrolled in at the bottom
+    if (lores_native && !(op.N & 1)) {
+        for (uint8_t map_index = 0; map_index < 2; map_index++) {
+            if (color_plane & (1 << map_index)) {
+                row_base[map_index] = (row_base[map_index] + op.N / 2) % 32;
+                for (uint8_t j = 32 - op.N / 2; j < 32; j++) {
+                    *lores_row(map_index, j) = 0;
                 }
             }
-            break;
-        default:
-            std::cout << "Not implemented: " << std::hex << in.get_all() << std::endl;
-        }
-        break;
-    case 0x06:
-        // Store number NN in register VX
-        VX = NN;
-        break;
-    case 0x07:
-        // Add the value NN to register VX
-        VX += NN;
-        break;
-    case 0x08:
-        switch (in.get_low_low()) {
-        case 0x00:
-            // Store the value of register VY in register VX
-            VX = VY;
-            break;
-        case 0x01:
-            // Set VX to VX OR VY
-            VX |= VY;
-            break;
-        case 0x02:
-            // Set VX to VX AND VY
-            VX &= VY;
-            break;
-        case 0x03:
-            // Set VX to VX XOR VY
-            VX ^= VY;
-            break;
-        case 0x04:
-            // Add the value of register VY to register VX
-            VX += VY;
-            if (VX < VY)
-                VF = 0x01;
-            else
-                VF = 0x00;
-            break;
-        case 0x05:
-            // Subtract the value of register VY from register VX
-            N = VX;
-            VX = VX - VY;
-            if (VX <= N)
-                VF = 0x01;
-            else
-                VF = 0x00;
-            break;
-        case 0x06:
-            // Store the value of register VY shifted right one bit in register VX
-            N = VY & 0x01;
-            VX = VY >> 1;
-            VF = N;
-            break;
-        case 0x07:
-            // Set register VX to the value of VY minus VX
-            VX = VY - VX;
-            if (VX <= VY)
-                VF = 0x01;
-            else
-                VF = 0x00;
-            break;
-        case 0x0E:
-            // Store the value of register VY shifted left one bit in register VX
-            N = (VY & 0x80) >> 7;
-            VX = VY << 1;
-            VF = N;
-            break;
-        default:
-            std::cout << "Not implemented: " << std::hex << in.get_all() << std::endl;
         }
-        break;
-    case 0x09:
-        switch (in.get_low_low()) {
-        case 0x00:
-            // Skip the following instruction if the value of register VX is not equal to the value of register VY
-            if (VX != VY)
-                skip_next_instruction();
-            break;
-        default:
-            std::cout << "Not implemented: " << std::hex << in.get_all() << std::endl;
-        }
-        break;
-    case 0x0A:
-        // Store memory address NNN in register I
-        i_register = NNN;
-        break;
-    case 0x0B:
-        if (NNN + V0 > MEM_SIZE) return;
-        program_counter = NNN + V0;
+        dirty_rows = ALL_ROWS_DIRTY;
         return;
-    case 0x0C:
-        VX = (uint8_t)std::rand() & NN;
-        break;
-    case 0x0D:
-        // Draw a sprite at position VX, VY with N bytes of sprite data starting at the address stored in I
-        VF = 0;
-        if (N == 0)
-            N = 16;
-        NN = 0;
-        for (uint8_t bitmap_index = 0; bitmap_index < 2; bitmap_index++) {
-            if (color_plane & (1 << bitmap_index)) {
-                if (high_resolution && N == 16) {
-                    uint8_t sprite[32];
-                    for (uint8_t i = 0; i < 32; i++) {
-                        sprite[i] = memory[i_register + i + NN * 32];
-                    }
-                    draw_array_to_display(sprite, VX, VY, 2, 16, bitmap_index);
-                }
-                else if (high_resolution) {
-                    uint8_t sprite[16];
-                    for (uint8_t i = 0; i < N; i++) {
-                        sprite[i] = memory[i_register + i + NN * N];
-                    }
-                    draw_array_to_display(sprite, VX, VY, 1, N, bitmap_index);
-                }
-                else if (N == 16) {
-                    uint8_t sprite[128];  // (2 * 2) * 2 * N
-                    for (uint8_t i = 0; i < 16; i++) {
-                        sprite[8 * i] = double_upper_nibble(memory[i_register + 2 * i + NN * 32 ]);
-                        sprite[8 * i + 1] = double_upper_nibble(memory[i_register + 2 * i + NN * 32] << 4);
-                        sprite[8 * i + 2] = double_upper_nibble(memory[i_register + 2 * i + NN * 32 + 1]);
-                        sprite[8 * i + 3] = double_upper_nibble(memory[i_register + 2 * i + NN * 32 + 1] << 4);
-                        sprite[8 * i + 4] = double_upper_nibble(memory[i_register + 2 * i + NN * 32]);
-                        sprite[8 * i + 5] = double_upper_nibble(memory[i_register + 2 * i + NN * 32] << 4);
-                        sprite[8 * i + 6] = double_upper_nibble(memory[i_register + 2 * i + NN * 32 + 1]);
-                        sprite[8 * i + 7] = double_upper_nibble(memory[i_register + 2 * i + NN * 32 + 1] << 4);
-                    }
-                    draw_array_to_display(sprite, 2 * VX, 2 * VY, 4, 32, bitmap_index);
-                }
-                else {
-                    uint8_t sprite[64];  // (2 * 2) * N
-                    for (uint8_t i = 0; i < N; i++) {
-                        sprite[4 * i] = double_upper_nibble(memory[i_register + i + NN * N]);
-                        sprite[4 * i + 1] = double_upper_nibble(memory[i_register + i + NN * N] << 4);
-                        sprite[4 * i + 2] = double_upper_nibble(memory[i_register + i + NN * N]);
-                        sprite[4 * i + 3] = double_upper_nibble(memory[i_register + i + NN * N] << 4);
-                    }
-                    draw_array_to_display(sprite, 2 * VX, 2 * VY, 2, 2 * N, bitmap_index);
-                }
-                NN++;
+    }
+    if (lores_native)
+        lores_to_hires();
+    for (uint8_t map_index = 0; map_index < 2; map_index++) {
+        if (color_plane & (1 << map_index)) {
+            row_base[map_index] = (row_base[map_index] + op.N) % 64;
+            for (uint8_t j = 64 - op.N; j < 64; j++) {
+                memset(plane_row(map_index, j), 0, DISPLAY_ROW_WORDS * sizeof(uint64_t));
             }
         }
-        sync_display();
-        break;
-    case 0x0E:
-        // Key instructions
-        switch (in.get_low()) {
-        case 0x9E:
-            if (keys[VX])
-                skip_next_instruction();
-            break;
-        case 0xA1:
-            if (!keys[VX])
-                skip_next_instruction();
-            break;
-        default:
-            std::cout << "Not implemented: " << std::hex << in.get_all() << std::endl;
+    }
+    dirty_rows = ALL_ROWS_DIRTY;
+}
+
+void Emulator::op_clear(const Op&) {
+    // Clear the screen
+    clear_screen();
+}
+
+void Emulator::op_return(const Op&) {
+    // Return from a subroutine
+    program_counter = stack[--stack_pointer];
+}
+
+void Emulator::op_scroll_right(const Op&) {
+    // Scroll display 4 pixels right
+    scroll_planes(false);
+}
+
+void Emulator::op_scroll_left(const Op&) {
+    // Scroll display 4 pixels left
+    scroll_planes(true);
+}
+
+void Emulator::op_exit(const Op&) {
+    // Exit CHIP interpreter
+    paused = true;
+}
+
+void Emulator::op_low_res(const Op&) {
+    // Disable extended screen mode, going back to the native plane if the screen allows it
+    high_resolution = false;
+    if (!lores_native)
+        hires_to_lores();
+}
+
+void Emulator::op_high_res(const Op&) {
+    // Enable extended screen mode
+    high_resolution = true;
+    if (lores_native)
+        lores_to_hires();
+}
+
+void Emulator::op_jump(const Op& op) {
+    // Jump to NNN
+    program_counter = op.NNN;
+}
+
+void Emulator::op_call(const Op& op) {
+    // Call NNN
+    if (stack_pointer < sizeof(stack) / sizeof(stack[0])) {
+        stack[stack_pointer++] = program_counter;
+        program_counter = op.NNN;
+    }
+}
+
+void Emulator::op_skip_eq_imm(const Op& op) {
+    // Skip the following instruction if the value of register VX equals NN
+    if (register_file[op.X] == op.NN)
+        skip_next_instruction();
+}
+
+void Emulator::op_skip_ne_imm(const Op& op) {
+    // Skip the following instruction if the value of register VX is not equal to NN
+    if (register_file[op.X] != op.NN)
+        skip_next_instruction();
+}
+
+void Emulator::op_skip_eq_reg(const Op& op) {
+    // Skip the following instruction if the value of register VX is equal to the value of register VY
+    if (register_file[op.X] == register_file[op.Y])
+        skip_next_instruction();
+}
+
+void Emulator::op_save_range(const Op& op) {
+    // Save an inclusive range of registers to memory starting at I
+    uint8_t VX = register_file[op.X];
+    uint8_t VY = register_file[op.Y];
+    if (VY > VX && VX < 16 && VY < 16) {
+        for (uint8_t i = VX; i <= VY; i++) {
+            write_memory(i_register + i, register_file[i]);
+        }
+    }
+}
+
+void Emulator::op_load_range(const Op& op) {
+    // Load an inclusive range of registers from memory starting at I
+    uint8_t VX = register_file[op.X];
+    uint8_t VY = register_file[op.Y];
+    if (VY > VX && VX < 16 && VY < 16) {
+        for (uint8_t i = VX; i <= VY; i++) {
+            register_file[i] = memory[i_register + i];
         }
-        break;
-    case 0x0F:
-        switch (in.get_low()) {
-        case 0x00:
-            // Load I with a 16 bit address
-            if (in.get_high_low() != 0x0) break;
-            program_counter += 2;
-            Instruction address;
-            get_instruction(address);
-            i_register = address.get_all();
-            break;
-        case 0x01:
-            // Select zero or more drawing planes by bitmask(0 <= n <= 3).
-            N = in.get_high_low();
-            color_plane = N & 0x3;
-            break;
-        case 0x07:
-            // Store the current value of the delay timer in register VX
-            VX = delay_timer;
-            break;
-        case 0x0A:
-            // Wait for a keypress and store the result in register VX
-            uint8_t i;
-            if (!waiting_on_release) {
-                for (i = 0; i < 16; i++) {
-                    if (keys[i]) {
-                        VX = i;
-                        waiting_on_release = true;
-                    }
-                }
-                if (i == 16) {
-                    return;
+    }
+}
+
+void Emulator::op_load_imm(const Op& op) {
+    // Store number NN in register VX
+    register_file[op.X] = op.NN;
+}
+
+void Emulator::op_add_imm(const Op& op) {
+    // Add the value NN to register VX
+    register_file[op.X] += op.NN;
+}
+
+void Emulator::op_move(const Op& op) {
+    // Store the value of register VY in register VX
+    register_file[op.X] = register_file[op.Y];
+}
+
+void Emulator::op_or(const Op& op) {
+    // Set VX to VX OR VY
+    register_file[op.X] |= register_file[op.Y];
+}
+
+void Emulator::op_and(const Op& op) {
+    // Set VX to VX AND VY
+    register_file[op.X] &= register_file[op.Y];
+}
+
+void Emulator::op_xor(const Op& op) {
+    // Set VX to VX XOR VY
+    register_file[op.X] ^= register_file[op.Y];
+}
+
+void Emulator::op_add_reg(const Op& op) {
+    // Add the value of register VY to register VX
+    uint8_t& VX = register_file[op.X];
+    uint8_t& VY = register_file[op.Y];
+    VX += VY;
+    if (VX < VY)
+        register_file[0xF] = 0x01;
+    else
+        register_file[0xF] = 0x00;
+}
+
+void Emulator::op_sub_reg(const Op& op) {
+    // Subtract the value of register VY from register VX
+    uint8_t& VX = register_file[op.X];
+    uint8_t previous = VX;
+    VX = VX - register_file[op.Y];
+    if (VX <= previous)
+        register_file[0xF] = 0x01;
+    else
+        register_file[0xF] = 0x00;
+}
+
+void Emulator::op_shift_right(const Op& op) {
+    // Store the value of register VY shifted right one bit in register VX
+    uint8_t flag = register_file[op.Y] & 0x01;
+    register_file[op.X] = register_file[op.Y] >> 1;
+    register_file[0xF] = flag;
+}
+
+void Emulator::op_subn_reg(const Op& op) {
+    // Set register VX to the value of VY minus VX
+    uint8_t& VX = register_file[op.X];
+    uint8_t& VY = register_file[op.Y];
+    VX = VY - VX;
+    if (VX <= VY)
+        register_file[0xF] = 0x01;
+    else
+        register_file[0xF] = 0x00;
+}
+
+void Emulator::op_shift_left(const Op& op) {
+    // Store the value of register VY shifted left one bit in register VX
+    uint8_t flag = (register_file[op.Y] & 0x80) >> 7;
+    register_file[op.X] = register_file[op.Y] << 1;
+    register_file[0xF] = flag;
+}
+
+void Emulator::op_skip_ne_reg(const Op& op) {
+    // Skip the following instruction if the value of register VX is not equal to the value of register VY
+    if (register_file[op.X] != register_file[op.Y])
+        skip_next_instruction();
+}
+
+void Emulator::op_load_i(const Op& op) {
+    // Store memory address NNN in register I
+    i_register = op.NNN;
+}
+
+void Emulator::op_jump_v0(const Op& op) {
+    // Jump to NNN + V0
+    program_counter = op.NNN + register_file[0x0];
+}
+
+void Emulator::op_random(const Op& op) {
+    // SplitMix64
+    uint64_t bits = random_state += 0x9E3779B97F4A7C15ull;
+    bits = (bits ^ (bits >> 30)) * 0xBF58476D1CE4E5B9ull;
+    bits = (bits ^ (bits >> 27)) * 0x94D049BB133111EBull;
+    bits ^= bits >> 31;
+    register_file[op.X] = (uint8_t)(bits >> 56) & op.NN;
+}
+
+void Emulator::op_draw(const Op& op) {
+    // Draw a sprite at position VX, VY with N bytes of sprite data starting at the address stored in I
+    uint8_t VX = register_file[op.X];
+    uint8_t VY = register_file[op.Y];
+    uint8_t N = op.N;
+    uint8_t plane_count = 0;
+    register_file[0xF] = 0;
+    for (uint8_t bitmap_index = 0; bitmap_index < 2; bitmap_index++) {
+        if (color_plane & (1 << bitmap_index)) {
+            // With both planes selected the second plane's sprite follows the first one in memory
+            uint16_t address = i_register + plane_count * (N == 16 ? 32 : N);
+            if (high_resolution || lores_native) {
+                uint64_t rows[16];
+                for (uint8_t i = 0; i < N; i++) {
+                    if (N == 16)
+                        rows[i] = ((uint64_t)memory[(uint16_t)(address + 2 * i)] << 56) | ((uint64_t)memory[(uint16_t)(address + 2 * i + 1)] << 48);
+                    else
+                        rows[i] = (uint64_t)memory[(uint16_t)(address + i)] << 56;
                 }
+                if (high_resolution)
+                    draw_rows(rows, VX, VY, N, bitmap_index);
+                else
+                    draw_lores_rows(rows, VX, VY, N, bitmap_index);
             }
             else {
-                for (i = 0; i < 16; i++) {
-                    if (keys[i]) return;
-                }
-                waiting_on_release = false;
-            }
-            break;
-        case 0x15:
-            // Set the delay timer to the value of register VX
-            delay_timer = VX;
-            break;
-        case 0x18:
-            // Set the sound timer to the value of VX
-            sound_timer = VX;
-            break;
-        case 0x1E:
-            // Add the value stored in register VX to register I
-            i_register += VX;
-            break;
-        case 0x29:
-            // Set I to the memory address of the sprite data corresponding to the hexadecimal digit stored in register VX
-            if (VX < 0x10)
-                i_register = 5 * VX;
-            break;
-        case 0x30:
-            // Point I to a 10-byte font sprite for digit VX (0-9)
-            if (VX < 0xA)
-                i_register = 0x50 + 10 * VX;
-            break;
-
-        case 0x33:
-            // Store the binary-coded decimal equivalent of the value stored in register VX at addresses I, I+1, and I+2
-            if (i_register < 0xFFFE) {
-                memory[i_register] = VX / 100;
-                memory[i_register + 1] = (VX / 10) % 10;
-                memory[i_register + 2] = VX % 10;
+                // Low resolution on a high resolution screen, after an odd scroll or a mode switch
+                const Sprite& sprite = sprite_cache.fetch(memory, address, N, N == 16);
+                draw_rows(sprite.bits, 2 * VX, 2 * VY, sprite.rows, bitmap_index);
             }
-            break;
-        case 0x55:
-            // Store the values of registers V0 to VX inclusive in memory starting at address I
-            // I is set to I + X + 1 after operation
-            for (int i = 0; i <= X; i++) {
-                memory[i_register + i] = register_file[i];
-            }
-            i_register += X + 1;
-            break;
-        case 0x65:
-            // Fill registers V0 to VX inclusive with the values stored in memory starting at address I
-            // I is set to I + X + 1 after operation
-            for (int i = 0; i <= X; i++) {
-                register_file[i] = memory[i_register + i];
-            }
-            i_register += X + 1;
-            break;
-        case 0x75:
-            // Store V0..VX in RPL user flags
-            if (VX < 16)
-                memcpy(rpl_file, register_file, VX);
-            break;
-        case 0x85:
-            // Load V0..Vx from RPL user flags
-            if (VX < 16)
-                memcpy(register_file, rpl_file, VX);
-            break;
-        default:
-            std::cout << "Not implemented: " << std::hex << in.get_all() << std::endl;
+            plane_count++;
         }
-        break;
-    default:
-        std::cout << "Not implemented: " << std::hex << in.get_all() << std::endl;
     }
+}
+
+void Emulator::op_skip_key(const Op& op) {
+    if (keys[register_file[op.X]])
+        skip_next_instruction();
+}
+
+void Emulator::op_skip_not_key(const Op& op) {
+    if (!keys[register_file[op.X]])
+        skip_next_instruction();
+}
+
+void Emulator::op_load_long_i(const Op&) {
+    // Load I with a 16 bit address
+    Instruction address;
+    get_instruction(address);
+    i_register = address.get_all();
     program_counter += 2;
 }
 
-void Emulator::tick_timers() {
-    if (counter++ > 8) {
-        counter = 0;
-        if (delay_timer)
-            delay_timer--;
-        if (sound_timer)
-            sound_timer--;
+void Emulator::op_plane(const Op& op) {
+    // Select zero or more drawing planes by bitmask(0 <= n <= 3).
+    color_plane = op.X & 0x3;
+}
+
+void Emulator::op_get_delay(const Op& op) {
+    // Store the current value of the delay timer in register VX
+    register_file[op.X] = delay_timer;
+}
+
+void Emulator::op_wait_key(const Op& op) {
+    // Wait for a keypress and store the result in register VX, then wait for it to be released
+    if (!waiting_on_release) {
+        for (uint8_t i = 0; i < 16; i++) {
+            if (keys[i]) {
+                register_file[op.X] = i;
+                waiting_on_release = true;
+            }
+        }
+        program_counter -= 2;
+        return;
+    }
+    for (uint8_t i = 0; i < 16; i++) {
+        if (keys[i]) {
+            program_counter -= 2;
+            return;
+        }
+    }
+    waiting_on_release = false;
+}
+
+void Emulator::op_set_delay(const Op& op) {
+    // Set the delay timer to the value of register VX
+    delay_timer = register_file[op.X];
+}
+
+void Emulator::op_set_sound(const Op& op) {
+    // Set the sound timer to the value of VX
+    sound_timer = register_file[op.X];
+}
+
+void Emulator::op_add_i(const Op& op) {
+    // Add the value stored in register VX to register I
+    i_register += register_file[op.X];
+}
+
+void Emulator::op_font_i(const Op& op) {
+    // Set I to the memory address of the sprite data corresponding to the hexadecimal digit stored in register VX
+    uint8_t VX = register_file[op.X];
+    if (VX < 0x10)
+        i_register = 5 * VX;
+}
+
+void Emulator::op_big_font_i(const Op& op) {
+    // Point I to a 10-byte font sprite for digit VX (0-9)
+    uint8_t VX = register_file[op.X];
+    if (VX < 0xA)
+        i_register = 0x50 + 10 * VX;
+}
+
+void Emulator::op_bcd(const Op& op) {
+    // Store the binary-coded decimal equivalent of the value stored in register VX at addresses I, I+1, and I+2
+    uint8_t VX = register_file[op.X];
+    if (i_register < 0xFFFE) {
+        write_memory(i_register, VX / 100);
+        write_memory(i_register + 1, (VX / 10) % 10);
+        write_memory(i_register + 2, VX % 10);
+    }
+}
+
+void Emulator::op_store(const Op& op) {
+    // Store the values of registers V0 to VX inclusive in memory starting at address I
+    // I is set to I + X + 1 after operation
+    for (int i = 0; i <= op.X; i++) {
+        write_memory(i_register + i, register_file[i]);
+    }
+    i_register += op.X + 1;
+}
+
+void Emulator::op_load(const Op& op) {
+    // Fill registers V0 to VX inclusive with the values stored in memory starting at address I
+    // I is set to I + X + 1 after operation
+    for (int i = 0; i <= op.X; i++) {
+        register_file[i] = memory[i_register + i];
     }
+    i_register += op.X + 1;
+}
+
+void Emulator::op_save_flags(const Op& op) {
+    // Store V0..VX in RPL user flags
+    uint8_t VX = register_file[op.X];
+    if (VX < 16)
+        memcpy(rpl_file, register_file, VX);
+}
+
+void Emulator::op_load_flags(const Op& op) {
+    // Load V0..Vx from RPL user flags
+    uint8_t VX = register_file[op.X];
+    if (VX < 16)
+        memcpy(register_file, rpl_file, VX);
+}
+
+void Emulator::tick_timers() {
+    if (delay_timer)
+        delay_timer--;
+    if (sound_timer)
+        sound_timer--;
 }
 
 void Emulator::step() {
+    if (instrumented()) {
+        instrumented_step();
+        instruction_count++;
+        return;
+    }
     Instruction in;
-    set_keys();
     get_instruction(in);
     execute(in);
+    instruction_count++;
+}
+
+void Emulator::run_frame() {
+    run_cycles(cycles_per_frame);
     tick_timers();
 }
 
-void Emulator::tick() {
-    while (true) {
-        double current_time = (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
-        if (current_time - time < 0) {  // Return once we've caught up
-            return;
+uint32_t Emulator::run_cycles(uint32_t count) {
+    // Engines return the instructions they did not get to, which is only non zero when the program paused
+    uint32_t left;
+    if (instrumented())
+        left = run_instrumented(count);
+    else if (engine == Engine::BlockCache)
+        left = run_blocks(count);
+    else if (engine == Engine::Jit)
+        left = run_jit(count);
+    else if (engine == Engine::Aot && aot.loaded())
+        left = run_aot(count);
+#if THREADED_SUPPORTED
+    else if (engine == Engine::Threaded)
+        left = run_threaded(count);
+#endif
+    else
+        left = run_interpreter(count);
+    instruction_count += count - left;
+    return count - left;
+}
+
+uint32_t Emulator::run_interpreter(uint32_t count) {
+    for (; count && !paused; count--) {
+        Instruction in;
+        get_instruction(in);
+        execute(in);
+    }
+    return count;
+}
+
+bool Emulator::instrumented() const {
+#if CHIP8_TRACE
+    if (tracer)
+        return true;
+#endif
+    return profiler != nullptr;
+}
+
+void Emulator::instrumented_step() {
+    uint16_t pc = program_counter;
+    Instruction in;
+    get_instruction(in);
+#if CHIP8_TRACE
+    uint8_t before[16]{};
+    if (tracer)
+        memcpy(before, register_file, sizeof(before));
+#endif
+    if (profiler) {
+        profiler->count(pc, in.get_all());
+        if (profiler->sample()) {
+            uint64_t start = profile_clock();
+            execute(in);
+            profiler->add_sample(in.get_all(), profile_clock() - start);
         }
-        time = time + frequency / 1000;
+        else
+            execute(in);
+    }
+    else
+        execute(in);
+#if CHIP8_TRACE
+    if (tracer)
+        tracer->record(pc, in.get_all(), i_register, before, register_file);
+#endif
+}
+
+uint32_t Emulator::run_instrumented(uint32_t count) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t start_ticks = profile_clock();
+    for (; count && !paused; count--) {
+        instrumented_step();
+    }
+    if (profiler)
+        profiler->add_run(profile_clock() - start_ticks, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    return count;
+}
+
+uint32_t Emulator::execute_block(const Block& block, uint32_t count) {
+    uint32_t length = block.length < count ? block.length : count;
+    for (uint32_t i = 0; i < length; i++) {
+        // Copied out, a store at the end of the block may invalidate it while its handler runs
+        Op op = block.ops[i];
+        program_counter += 2;
+        op.handler(*this, op);
+    }
+    return length;
+}
+
+uint32_t Emulator::run_blocks(uint32_t count) {
+    while (count && !paused) {
+        count -= execute_block(block_cache.fetch(memory, program_counter), count);
+    }
+    return count;
+}
 
-        if (!paused && frequency > 0.009) {
-            step();
+uint32_t Emulator::run_jit(uint32_t count) {
+    while (count && !paused) {
+        Block& block = block_cache.fetch(memory, program_counter);
+        if (!block.native && ++block.hits == JIT_HOT_THRESHOLD)
+            jit.compile(*this, block, block_cache);
+        if (block.native && block.length <= count) {
+            ((JitBlockFn)block.native)(this);
+            count -= block.length;
         }
-        else if (step_once) {
-            step_once = false;
-            step();
+        else {
+            count -= execute_block(block, count);
+        }
+    }
+    return count;
+}
+
+uint32_t Emulator::run_aot(uint32_t count) {
+    while (count && !paused) {
+        const AotBlock* block = aot.lookup(program_counter);
+        if (block && block->length <= count) {
+            block->function(&aot_state);
+            count -= block->length;
         }
         else {
-            time = current_time;
-            return;
+            // Not statically reachable (BNNN targets and the like), interpret until a compiled block is found
+            Instruction in;
+            get_instruction(in);
+            execute(in);
+            count--;
+        }
+        // Stores end compiled blocks, so this is seen before any stale code runs
+        if (aot.invalidated) {
+            // The ROM wrote into its own code, the compiled module no longer matches it
+            std::cout << "ROM modified compiled code, unloading AOT module" << std::endl;
+            aot.unload();
+            return run_interpreter(count);
         }
     }
+    return count;
 }
 
-void Emulator::render() {
-    editor.DrawWindow("Memory", memory, MEM_SIZE);
-    editor.DrawWindow("Registers", register_file, 16);
-    editor.DrawWindow("Stack", stack, sizeof(stack));
+void Emulator::aot_execute(void* emulator, uint16_t opcode) {
+    const Op& op = decode_table[opcode];
+    op.handler(*(Emulator*)emulator, op);
+}
+
+#if THREADED_SUPPORTED
+uint32_t Emulator::run_threaded(uint32_t count) {
+    // Indexed by OpKind. Control flow and the register ops are implemented inline, everything else calls
+    // its regular handler.
+    static const void* const labels[] = {
+        &&handler,          // Unknown
+        &&nop,              // Nop
+        &&handler,          // ScrollDown
+        &&handler,          // ScrollUp
+        &&handler,          // Clear
+        &&op_return,        // Return
+        &&handler,          // ScrollRight
+        &&handler,          // ScrollLeft
+        &&handler,          // Exit
+        &&handler,          // LowRes
+        &&handler,          // HighRes
+        &&jump,             // Jump
+        &&call,             // Call
+        &&skip_eq_imm,      // SkipEqImm
+        &&skip_ne_imm,      // SkipNeImm
+        &&skip_eq_reg,      // SkipEqReg
+        &&handler,          // SaveRange
+        &&handler,          // LoadRange
+        &&load_imm,         // LoadImm
+        &&add_imm,          // AddImm
+        &&move,             // Move
+        &&op_or,            // Or
+        &&op_and,           // And
+        &&op_xor,           // Xor
+        &&add_reg,          // AddReg
+        &&sub_reg,          // SubReg
+        &&shift_right,      // ShiftRight
+        &&subn_reg,         // SubnReg
+        &&shift_left,       // ShiftLeft
+        &&skip_ne_reg,      // SkipNeReg
+        &&load_i,           // LoadI
+        &&jump_v0,          // JumpV0
+        &&handler,          // Random
+        &&handler,          // Draw
+        &&handler,          // SkipKey
+        &&handler,          // SkipNotKey
+        &&handler,          // LoadLongI
+        &&handler,          // Plane
+        &&get_delay,        // GetDelay
+        &&handler,          // WaitKey
+        &&set_delay,        // SetDelay
+        &&set_sound,        // SetSound
+        &&add_i,            // AddI
+        &&handler,          // FontI
+        &&handler,          // BigFontI
+        &&handler,          // Bcd
+        &&handler,          // Store
+        &&handler,          // Load
+        &&handler,          // SaveFlags
+        &&handler           // LoadFlags
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == (size_t)OpKind::Count, "Missing threaded label");
+
+    if (!count || paused)
+        return count;
+    ThreadedOp* code = threaded_code.prepare(&&decode);
+    ThreadedOp* current;
+    uint8_t* V = register_file;
+
+    // Every label ends by jumping straight to the label of the next instruction, there is no central
+    // dispatch branch. Only handlers can pause, so the inline ops skip that check.
+#define THREADED_FETCH() \
+    current = &code[program_counter]; \
+    program_counter += 2; \
+    goto *current->label
+#define THREADED_NEXT() \
+    if (--count == 0) \
+        return 0; \
+    THREADED_FETCH()
+
+    THREADED_FETCH();
+
+decode:
     {
-        if (ImGui::Begin("Special Registers")) {
-            if (ImGui::BeginTable("reg", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_Reorderable)) {
-                ImGui::TableSetupColumn("i_register");
-                ImGui::TableSetupColumn("program_counter");
-                ImGui::TableSetupColumn("next_instruction");
-                ImGui::TableSetupColumn("stack_pointer");
-                ImGui::TableSetupColumn("delay_timer");
-                ImGui::TableSetupColumn("sound_timer");
-                ImGui::TableHeadersRow();
-                ImGui::TableNextColumn();
-                ImGui::Text("%04x", i_register);
-                ImGui::TableNextColumn();
-                ImGui::Text("%04x", program_counter);
-                Instruction in;
-                get_instruction(in);
-                ImGui::TableNextColumn();
-                ImGui::Text("%04x", in.get_all());
-                ImGui::TableNextColumn();
-                ImGui::Text("%02x", stack_pointer);
-                ImGui::TableNextColumn();
-                ImGui::Text("%04x", delay_timer);
-                ImGui::TableNextColumn();
-                ImGui::Text("%04x", sound_timer);
-                ImGui::EndTable();
-            }
-        }
-        ImGui::End();
+        uint16_t address = (uint16_t)(current - code);
+        uint16_t opcode = (memory[address] << 8) | memory[(uint16_t)(address + 1)];
+        current->op = decode_table[opcode];
+        current->label = labels[(size_t)decode_kind(opcode)];
+        goto *current->label;
+    }
+handler:
+    current->op.handler(*this, current->op);
+    if (--count == 0 || paused)
+        return count;
+    THREADED_FETCH();
+nop:
+    THREADED_NEXT();
+op_return:
+    program_counter = stack[--stack_pointer];
+    THREADED_NEXT();
+jump:
+    program_counter = current->op.NNN;
+    THREADED_NEXT();
+call:
+    if (stack_pointer < sizeof(stack) / sizeof(stack[0])) {
+        stack[stack_pointer++] = program_counter;
+        program_counter = current->op.NNN;
     }
+    THREADED_NEXT();
+skip_eq_imm:
+    if (V[current->op.X] == current->op.NN)
+        skip_next_instruction();
+    THREADED_NEXT();
+skip_ne_imm:
+    if (V[current->op.X] != current->op.NN)
+        skip_next_instruction();
+    THREADED_NEXT();
+skip_eq_reg:
+    if (V[current->op.X] == V[current->op.Y])
+        skip_next_instruction();
+    THREADED_NEXT();
+skip_ne_reg:
+    if (V[current->op.X] != V[current->op.Y])
+        skip_next_instruction();
+    THREADED_NEXT();
+load_imm:
+    V[current->op.X] = current->op.NN;
+    THREADED_NEXT();
+add_imm:
+    V[current->op.X] += current->op.NN;
+    THREADED_NEXT();
+move:
+    V[current->op.X] = V[current->op.Y];
+    THREADED_NEXT();
+op_or:
+    V[current->op.X] |= V[current->op.Y];
+    THREADED_NEXT();
+op_and:
+    V[current->op.X] &= V[current->op.Y];
+    THREADED_NEXT();
+op_xor:
+    V[current->op.X] ^= V[current->op.Y];
+    THREADED_NEXT();
+add_reg:
+    V[current->op.X] += V[current->op.Y];
+    V[0xF] = V[current->op.X] < V[current->op.Y] ? 0x01 : 0x00;
+    THREADED_NEXT();
+sub_reg:
     {
-        if (ImGui::BeginMainMenuBar()) {
-            if (ImGui::BeginMenu("File")) {
-                if (ImGui::MenuItem("Open File")) {
-                    file_dialog.Open();
-                }
-                ImGui::EndMenu();
-            }
-            ImGui::EndMainMenuBar();
-        }
-        file_dialog.Display();
-        if (file_dialog.HasSelected()) {
-            load_file(file_dialog.GetSelected().string().c_str());
-            file_dialog.ClearSelected();
-        }
+        uint8_t previous = V[current->op.X];
+        V[current->op.X] = previous - V[current->op.Y];
+        V[0xF] = V[current->op.X] <= previous ? 0x01 : 0x00;
     }
+    THREADED_NEXT();
+shift_right:
     {
-        ImGui::Begin("Interpreter Controls");
-        if (ImGui::Button("Pause")) {
-            paused = true;
-        }
-        ImGui::SameLine();
-        if (ImGui::Button("Resume")) {
-            paused = false;
-        }
-        ImGui::SameLine();
-        if (ImGui::Button("Step")) {
-            step_once = true;
-        }
-        ImGui::SameLine();
-        if (ImGui::Button("Palate")) {
-            ImGui::OpenPopup("palate_picker");
-        }
-        if (ImGui::BeginPopup("palate_picker")) {
-            if (ImGui::Button("Apply")) {
-                for (int i = 0; i < 4; i++) {
-                    palate[i].r = (uint8_t)(color_select[i][0] * 255);
-                    palate[i].g = (uint8_t)(color_select[i][1] * 255);
-                    palate[i].b = (uint8_t)(color_select[i][2] * 255);
-                    palate[i].a = 255;
-                }
-                sync_display();
-            }
-            for (int i = 0; i < 4; i++) {
-                ImGui::ColorPicker3((std::string("Palate: ") + std::to_string(i)).c_str(), color_select[i], ImGuiColorEditFlags_PickerHueWheel | ImGuiColorEditFlags_NoInputs);
-                ImGui::SameLine();
-            }
-            ImGui::EndPopup();
-        }
-        ImGui::SameLine();
-        if (ImGui::Button("Frequency")) {
-            ImGui::OpenPopup("Frequency Selector");
-        }
-        if (ImGui::BeginPopup("Frequency Selector")) {
-            ImGui::DragFloat("Frequency (ms)", &frequency, 0.1f, 0.1f, 10000);
-            ImGui::EndPopup();
-        }
-        ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-        ImGui::End();
+        uint8_t flag = V[current->op.Y] & 0x01;
+        V[current->op.X] = V[current->op.Y] >> 1;
+        V[0xF] = flag;
+    }
+    THREADED_NEXT();
+subn_reg:
+    V[current->op.X] = V[current->op.Y] - V[current->op.X];
+    V[0xF] = V[current->op.X] <= V[current->op.Y] ? 0x01 : 0x00;
+    THREADED_NEXT();
+shift_left:
+    {
+        uint8_t flag = V[current->op.Y] >> 7;
+        V[current->op.X] = V[current->op.Y] << 1;
+        V[0xF] = flag;
     }
+    THREADED_NEXT();
+load_i:
+    i_register = current->op.NNN;
+    THREADED_NEXT();
+jump_v0:
+    program_counter = current->op.NNN + V[0x0];
+    THREADED_NEXT();
+get_delay:
+    V[current->op.X] = delay_timer;
+    THREADED_NEXT();
+set_delay:
+    delay_timer = V[current->op.X];
+    THREADED_NEXT();
+set_sound:
+    sound_timer = V[current->op.X];
+    THREADED_NEXT();
+add_i:
+    i_register += V[current->op.X];
+    THREADED_NEXT();
+#undef THREADED_NEXT
+#undef THREADED_FETCH
 }
+#endif
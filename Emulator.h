@@ -1,16 +1,59 @@
 #pragma once
 #include <cstdint>
-#include "vk_init.h"
-#include "imgui.h"
-#include "imgui_memory_editor.h"
-#include "imfilebrowser.h"
+#include "Color.h"
+#include "Decoder.h"
+#include "DisplayKernels.h"
+#include "BlockCache.h"
+#include "Jit.h"
+#include "Aot.h"
+#include "Threaded.h"
+#include "SpriteCache.h"
+#include "MachineState.h"
+#include "Trace.h"
+#include "Profiler.h"
 
+#include <array>
+#include <cstdio>
 #include <set>
+#include <string>
 
-#define MEM_SIZE 0x10000
+#define FRAME_RATE 60
+#define MAX_CYCLES_PER_FRAME 1000000
+#define ALL_ROWS_DIRTY (~0ull)
+#define DEFAULT_RANDOM_SEED 0x2545F4914F6CDD1Dull
+
+// Rotates the 128 bit value high:low right by shift (0-127) bits
+inline void rotate_right_128(uint64_t& high, uint64_t& low, unsigned shift) {
+    if (shift >= 64) {
+        uint64_t swap = high;
+        high = low;
+        low = swap;
+        shift -= 64;
+    }
+    if (shift) {
+        uint64_t new_high = (high >> shift) | (low << (64 - shift));
+        low = (low >> shift) | (high << (64 - shift));
+        high = new_high;
+    }
+}
+
+// Doubles each of the 32 low resolution pixels in bits, most significant bit first
+inline uint64_t double_pixels(uint32_t bits) {
+    return ((uint64_t)double_table[bits >> 24] << 48) | ((uint64_t)double_table[(bits >> 16) & 0xFF] << 32) |
+        ((uint64_t)double_table[(bits >> 8) & 0xFF] << 16) | double_table[bits & 0xFF];
+}
+
+// Inverse of double_pixels, keeps the left bit of every pair
+inline uint32_t halve_pixels(uint64_t bits) {
+    bits = (bits >> 1) & 0x5555555555555555ull;
+    bits = (bits | (bits >> 1)) & 0x3333333333333333ull;
+    bits = (bits | (bits >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    bits = (bits | (bits >> 4)) & 0x00FF00FF00FF00FFull;
+    bits = (bits | (bits >> 8)) & 0x0000FFFF0000FFFFull;
+    return (uint32_t)(bits | (bits >> 16));
+}
 
 #define get_screen_pos(x, y) (uint8_t)((y) % 0x40)*128 + (uint8_t)((x) % 0x80)
-#define double_upper_nibble(data) ((data) & 0x80) | (((data) >> 1) & 0x60) | (((data) >> 2) & 0x18) | (((data) >> 3) & 0x06) | (((data) >> 4) & 0x01)
 const uint8_t font_data[] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0,
     0x20, 0x60, 0x20, 0x20, 0x70,
@@ -40,25 +83,6 @@ const uint8_t font_data[] = {
     0x7E, 0xFF, 0xC3, 0xC3, 0xFF, 0x7F, 0x03, 0xC3, 0xFF, 0x7E
 };
 
-const ImGuiKey key_map[] = {
-    ImGuiKey_X,
-    ImGuiKey_1,
-    ImGuiKey_2,
-    ImGuiKey_3,
-    ImGuiKey_Q,
-    ImGuiKey_W,
-    ImGuiKey_E,
-    ImGuiKey_A,
-    ImGuiKey_S,
-    ImGuiKey_D,
-    ImGuiKey_Z,
-    ImGuiKey_C,
-    ImGuiKey_4,
-    ImGuiKey_R,
-    ImGuiKey_F,
-    ImGuiKey_V
-};
-
 struct Instruction {
     uint16_t data;
     uint16_t get_all() { return (data << 8) | (data >> 8); }
@@ -70,64 +94,209 @@ struct Instruction {
     uint8_t get_low_low() { return (data >> 8) & 0x000F; }
     std::string toString() {
         char hex_string[10];
-        sprintf_s(hex_string, "%02x %02x", get_high(), get_low());
+        snprintf(hex_string, sizeof(hex_string), "%02x %02x", get_high(), get_low());
         return std::string(hex_string);
     }
 };
 
-class Emulator
+enum class Engine : int {
+    Interpreter,    // Fetch and dispatch one instruction at a time, the reference implementation
+    BlockCache,     // Execute cached runs of predecoded instructions
+    Jit,            // Block cache with hot blocks compiled to native code
+    Aot,            // Blocks from a module built by tools/ch8aot for the loaded ROM, interprets without one
+    Threaded        // Direct threaded dispatch through computed goto, when THREADED_SUPPORTED
+};
+
+class Emulator : private MachineState
 {
 private:
-    bool paused = false;
-    bool step_once = false;
+    friend class Jit;
+    friend class Debugger;
+    template <int LANES> friend class Lockstep;
+
+    Engine engine{ Engine::Interpreter };
 
     // Display variables
     Color* display;
-    uint8_t display_bitmap[2][16 * 64];
+    uint64_t dirty_rows{ ALL_ROWS_DIRTY };  // Bit n set when row n of display_bitmap changed since sync_display
+    ExpandPlanesFn expand_planes;           // Bitplane to RGBA conversion, picked for this CPU
+    ScrollKernel scroll;                    // 00FB/00FC row shifts, picked for this CPU
     Color palate[4] = {
         { 0x00, 0x00, 0x00, 0xFF },  // Black
         { 0xFF, 0xFF, 0xFF, 0xFE },  // White
         { 0x55, 0x55, 0x55, 0xFD },  // Dark Gray
         { 0xAA, 0xAA, 0xAA, 0xFC }   // Light Gray
     };
-    float color_select[4][3];
-    uint8_t color_plane{ 1 };
-
-    bool high_resolution{ false };
     bool palate_select{ false };
     // Timing
-    float frequency{ 2 };
-    double time = 0;
-    uint32_t counter = 0;
-    uint8_t delay_timer = 0;
-    uint8_t sound_timer = 0;
-    // Memory
-    uint8_t* memory;
-    uint16_t stack[0x1000];
-    uint8_t register_file[16];
-    uint8_t rpl_file[16];
-    uint16_t program_counter = 0x0200;
-    uint8_t stack_pointer = 0x00;
-    uint16_t i_register = 0x0000;
-    // IO
-    bool keys[16];
-    bool waiting_on_release{ false };
-    MemoryEditor editor;
-    ImGui::FileBrowser file_dialog{ImGuiFileBrowserFlags_NoModal};
+    uint32_t cycles_per_frame{ 10 };
+    uint64_t random_seed{ DEFAULT_RANDOM_SEED };   // random_state after a load
+    // Caches of what is in memory
+    BlockCache block_cache;
+    Jit jit;
+    ThreadedCode threaded_code;
+    SpriteCache sprite_cache;
+    Aot aot;
+    AotState aot_state;
+    // Instrumentation, either sends every instruction through run_instrumented
+#if CHIP8_TRACE
+    Tracer* tracer{ nullptr };
+#endif
+    Profiler* profiler{ nullptr };
 
     void get_instruction(Instruction& in);
-    void sync_display();
-    void draw_array_to_display(uint8_t* byte_array, uint8_t x, uint8_t y, int width, int height, uint8_t bitmap_index);
+    void write_memory(uint16_t address, uint8_t value) {
+        memory[address] = value;
+        if (block_cache.is_code(address))
+            block_cache.invalidate(address);
+        if (aot.is_code(address))
+            aot.invalidated = true;
+        threaded_code.invalidate(address);
+        if (sprite_cache.covers(address))
+            sprite_cache.invalidate(address);
+    }
+    uint64_t* plane_row(uint8_t plane, uint8_t row) { return display_bitmap[plane][(row + row_base[plane]) % 64]; }
+    uint64_t* lores_row(uint8_t plane, uint8_t row) { return &lores_bitmap[plane][(row + row_base[plane]) % 32]; }
+    // Screen row `row` of both planes into out, laid out as read_planes writes them
+    void read_row(uint8_t row, uint64_t* out) const;
+    // Moves the screen between the two representations, hires_to_lores fails if it is not made of doubled pixels
+    void lores_to_hires();
+    bool hires_to_lores();
+    // Draws one left aligned word per row, at most 64 pixels wide
+    void draw_rows(const uint64_t* rows, uint8_t x, uint8_t y, int height, uint8_t map_index);
+    void draw_lores_rows(const uint64_t* rows, uint8_t x, uint8_t y, int height, uint8_t map_index);
     void skip_next_instruction();
     void execute(Instruction& in);
+
+    // Opcode handlers, reached through decode_table. program_counter already points at the next instruction.
+    template <void (Emulator::*handler)(const Op&)>
+    static void dispatch(Emulator& emu, const Op& op) { (emu.*handler)(op); }
+    static constexpr std::array<Op, 0x10000> build_decode_table();
+    void op_unknown(const Op& op);
+    void op_nop(const Op& op);
+    void op_scroll_down(const Op& op);
+    void op_scroll_up(const Op& op);
+    void op_clear(const Op& op);
+    void op_return(const Op& op);
+    void op_scroll_right(const Op& op);
+    void op_scroll_left(const Op& op);
+    void op_exit(const Op& op);
+    void op_low_res(const Op& op);
+    void op_high_res(const Op& op);
+    void op_jump(const Op& op);
+    void op_call(const Op& op);
+    void op_skip_eq_imm(const Op& op);
+    void op_skip_ne_imm(const Op& op);
+    void op_skip_eq_reg(const Op& op);
+    void op_save_range(const Op& op);
+    void op_load_range(const Op& op);
+    void op_load_imm(const Op& op);
+    void op_add_imm(const Op& op);
+    void op_move(const Op& op);
+    void op_or(const Op& op);
+    void op_and(const Op& op);
+    void op_xor(const Op& op);
+    void op_add_reg(const Op& op);
+    void op_sub_reg(const Op& op);
+    void op_shift_right(const Op& op);
+    void op_subn_reg(const Op& op);
+    void op_shift_left(const Op& op);
+    void op_skip_ne_reg(const Op& op);
+    void op_load_i(const Op& op);
+    void op_jump_v0(const Op& op);
+    void op_random(const Op& op);
+    void op_draw(const Op& op);
+    void op_skip_key(const Op& op);
+    void op_skip_not_key(const Op& op);
+    void op_load_long_i(const Op& op);
+    void op_plane(const Op& op);
+    void op_get_delay(const Op& op);
+    void op_wait_key(const Op& op);
+    void op_set_delay(const Op& op);
+    void op_set_sound(const Op& op);
+    void op_add_i(const Op& op);
+    void op_font_i(const Op& op);
+    void op_big_font_i(const Op& op);
+    void op_bcd(const Op& op);
+    void op_store(const Op& op);
+    void op_load(const Op& op);
+    void op_save_flags(const Op& op);
+    void op_load_flags(const Op& op);
+
     void tick_timers();
-    void step();
-    void load_file(const char* filename);
-    void set_keys();
+    // Each returns how many of the count instructions were left when it stopped
+    uint32_t run_interpreter(uint32_t count);
+    uint32_t run_blocks(uint32_t count);
+    uint32_t run_jit(uint32_t count);
+    uint32_t run_aot(uint32_t count);
+    uint32_t run_threaded(uint32_t count);
+    // The interpreter feeding the tracer and profiler, used whatever the engine while either is set
+    bool instrumented() const;
+    uint32_t run_instrumented(uint32_t count);
+    void instrumented_step();
+    static void aot_execute(void* emulator, uint16_t opcode);
+    uint32_t execute_block(const Block& block, uint32_t count);
+    void scroll_planes(bool left);
     void clear_screen();
+    void clear_caches();
+    // Picks up the AOT module for rom_hash if there is one
+    void load_aot();
 public:
+    // Indexed by the full 16 bit opcode
+    static const std::array<Op, 0x10000> decode_table;
+
     Emulator(Color display[]);
-    ~Emulator();
-    void tick();
-    void render();
+    void load_file(const char* filename);
+    // Copies a ROM image to 0x200 and resets the machine, as load_file does for a file
+    void load_rom(const uint8_t* data, uint32_t size);
+    // Runs count instructions on the selected engine. No clock, input or UI calls happen in between.
+    // Returns the number executed, less than count only if the program paused.
+    uint32_t run_cycles(uint32_t count);
+    // Runs cycles_per_frame instructions and ticks the timers once, one 60Hz frame of emulated time
+    void run_frame();
+    uint32_t get_cycles_per_frame() const { return cycles_per_frame; }
+    void set_cycles_per_frame(uint32_t cycles) { cycles_per_frame = cycles; }
+    // Executes a single instruction without ticking the timers, for stepping through a paused program
+    void step();
+    // Converts the rows of the bitplanes that changed since the last call into display colors. Call it
+    // once per presented frame, the opcodes only mark rows dirty.
+    void sync_display();
+    // Makes the next sync_display convert every row, after the palette changed
+    void invalidate_display() { dirty_rows = ALL_ROWS_DIRTY; }
+    // Makes this machine an exact copy of other: memory, CPU, timers, screen and input. The palette and
+    // cycles_per_frame stay as they are. Same as load_state with other's state.
+    void copy_state(const Emulator& other);
+    // Save states: the whole machine as one block, see MachineState. Saving is a single copy. Loading one also
+    // drops the caches when its memory differs from the current contents, and switches the AOT module when it
+    // comes from another ROM.
+    void save_state(MachineState& out) const { out = *this; }
+    void load_state(const MachineState& state);
+    // Writes the screen as two high resolution planes of 64 rows, DISPLAY_ROW_WORDS words each, top row first
+    void read_planes(uint64_t* out) const;
+    // As read_planes, but only writes the rows that changed since the last call, so out must still hold
+    // what that call left. Takes the rows sync_display would convert, a machine uses one or the other.
+    void read_changed_planes(uint64_t* out);
+    // Bit i set means key i is held. Sampled by the key ops until the next call.
+    void set_keys(uint16_t mask);
+    bool is_paused() const { return paused; }
+    void set_paused(bool paused) { this->paused = paused; }
+    uint8_t get_register(uint8_t index) const { return register_file[index & 0xF]; }
+    uint16_t get_i_register() const { return i_register; }
+    uint16_t get_program_counter() const { return program_counter; }
+    // Since the last load, step and run_cycles both count
+    uint64_t get_instruction_count() const { return instruction_count; }
+    uint32_t get_unknown_opcode_count() const { return unknown_opcode_count; }
+    // CXNN draws from a generator in the machine state, seeded on every load, so runs with the same
+    // input repeat exactly. Takes effect now and on later loads.
+    void set_random_seed(uint64_t seed) { random_seed = seed; random_state = seed; }
+#if CHIP8_TRACE
+    // Records every instruction run from now on into tracer, nullptr stops. The tracer must outlive its use.
+    void set_tracer(Tracer* tracer) { this->tracer = tracer; }
+#endif
+    // Counts every instruction run from now on into profiler, nullptr stops. The profiler must outlive its use.
+    void set_profiler(Profiler* profiler) { this->profiler = profiler; }
+    Engine get_engine() const { return engine; }
+    // True when Engine::Aot has a module for the loaded ROM to run
+    bool has_aot_module() const { return aot.loaded(); }
+    void set_engine(Engine engine) { this->engine = engine; }
 };
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+// 64 bit FNV-1a, used to identify ROMs
+inline uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
@@ -0,0 +1,503 @@
+#include "Jit.h"
+#include "Emulator.h"
+
+#include <cstring>
+
+#if JIT_SUPPORTED
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+enum HostRegister { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+#define CC_B 0x2
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_BE 0x6
+#define CC_ALWAYS 0xFF
+
+// Callee saved on both the System V and Windows x64 ABIs, so they survive calls into handlers
+static const int pinned_registers[JIT_CACHED_REGISTERS] = { RBP, R12, R13, R14, R15 };
+
+Jit::~Jit() {
+#if JIT_SUPPORTED
+    if (code) {
+#ifdef _WIN32
+        VirtualFree(code, 0, MEM_RELEASE);
+#else
+        munmap(code, JIT_CODE_SIZE);
+#endif
+    }
+#endif
+}
+
+void Jit::reset(BlockCache& cache) {
+    used = 0;
+    cache.drop_native();
+}
+
+int32_t Jit::offset_of(const void* field) const {
+    return (int32_t)((const uint8_t*)field - (const uint8_t*)emu);
+}
+
+void Jit::emit8(uint8_t value) {
+    code[used++] = value;
+}
+
+void Jit::emit16(uint16_t value) {
+    memcpy(code + used, &value, sizeof(value));
+    used += sizeof(value);
+}
+
+void Jit::emit32(uint32_t value) {
+    memcpy(code + used, &value, sizeof(value));
+    used += sizeof(value);
+}
+
+void Jit::emit64(uint64_t value) {
+    memcpy(code + used, &value, sizeof(value));
+    used += sizeof(value);
+}
+
+void Jit::emit_rex(bool wide, int reg, int rm) {
+    uint8_t rex = 0x40 | (wide << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+    if (rex != 0x40)
+        emit8(rex);
+}
+
+// Register direct ModRM, 32 bit operands
+void Jit::emit_rm(int opcode, int reg, int rm) {
+    emit_rex(false, reg, rm);
+    emit8(opcode);
+    emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// [rbx + displacement]
+void Jit::emit_mem(int reg, int32_t displacement) {
+    emit8(0x80 | ((reg & 7) << 3) | RBX);
+    emit32(displacement);
+}
+
+void Jit::emit_mov(int dst, int src) {
+    if (dst != src)
+        emit_rm(0x89, src, dst);
+}
+
+void Jit::emit_alu(uint8_t opcode, int dst, int src) {
+    emit_rm(opcode, src, dst);
+}
+
+void Jit::emit_mov_imm(int dst, uint32_t value) {
+    emit_rex(false, 0, dst);
+    emit8(0xB8 + (dst & 7));
+    emit32(value);
+}
+
+// movzx r32, r8 on eax, ecx or edx
+void Jit::emit_zero_extend(int reg) {
+    emit8(0x0F);
+    emit8(0xB6);
+    emit8(0xC0 | (reg << 3) | reg);
+}
+
+void Jit::emit_setcc(uint8_t condition, int reg) {
+    emit8(0x0F);
+    emit8(0x90 | condition);
+    emit8(0xC0 | reg);
+    emit_zero_extend(reg);
+}
+
+void Jit::emit_load(int dst, uint8_t index) {
+    if (host_register[index] >= 0) {
+        emit_mov(dst, host_register[index]);
+        return;
+    }
+    // movzx dst, byte [rbx + register_file + index]
+    emit_rex(false, dst, RBX);
+    emit8(0x0F);
+    emit8(0xB6);
+    emit_mem(dst, offset_of(&emu->register_file[index]));
+}
+
+// src holds a zero extended byte in eax, ecx or edx
+void Jit::emit_store(uint8_t index, int src) {
+    if (host_register[index] >= 0) {
+        emit_mov(host_register[index], src);
+        dirty |= 1 << index;
+        return;
+    }
+    emit8(0x88);
+    emit_mem(src, offset_of(&emu->register_file[index]));
+}
+
+void Jit::emit_set_pc(uint16_t address) {
+    // mov word [rbx + program_counter], address
+    emit8(0x66);
+    emit8(0xC7);
+    emit_mem(0, offset_of(&emu->program_counter));
+    emit16(address);
+}
+
+size_t Jit::emit_jump(uint8_t condition) {
+    if (condition == CC_ALWAYS) {
+        emit8(0xE9);
+    }
+    else {
+        emit8(0x0F);
+        emit8(0x80 | condition);
+    }
+    size_t at = used;
+    emit32(0);
+    return at;
+}
+
+void Jit::patch_jump(size_t at) {
+    int32_t relative = (int32_t)(used - (at + 4));
+    memcpy(code + at, &relative, sizeof(relative));
+}
+
+// Calls function(emu, argument), the argument either as a 32 bit immediate or a pointer
+void Jit::emit_call(const void* function, const void* argument, bool immediate) {
+#ifdef _WIN32
+    const uint8_t first_argument[] = { 0x48, 0x89, 0xD9 };  // mov rcx, rbx
+    const uint8_t second_argument = RDX;
+#else
+    const uint8_t first_argument[] = { 0x48, 0x89, 0xDF };  // mov rdi, rbx
+    const uint8_t second_argument = RSI;
+#endif
+    for (uint8_t byte : first_argument) {
+        emit8(byte);
+    }
+    if (immediate) {
+        emit8(0xB8 + second_argument);
+        emit32((uint32_t)(uintptr_t)argument);
+    }
+    else {
+        emit8(0x48);
+        emit8(0xB8 + second_argument);
+        emit64((uint64_t)(uintptr_t)argument);
+    }
+    // mov rax, function; call rax
+    emit8(0x48);
+    emit8(0xB8);
+    emit64((uint64_t)(uintptr_t)function);
+    emit8(0xFF);
+    emit8(0xD0);
+}
+
+void Jit::spill() {
+    for (uint8_t i = 0; i < 16; i++) {
+        if (dirty & (1 << i)) {
+            // mov byte [rbx + register_file + i], r8 always needs a REX prefix to reach bpl and r12b-r15b
+            emit8(0x40 | ((host_register[i] & 8) >> 1));
+            emit8(0x88);
+            emit_mem(host_register[i], offset_of(&emu->register_file[i]));
+        }
+    }
+    dirty = 0;
+}
+
+void Jit::reload() {
+    for (uint8_t i = 0; i < 16; i++) {
+        if (host_register[i] >= 0) {
+            emit_rex(false, host_register[i], RBX);
+            emit8(0x0F);
+            emit8(0xB6);
+            emit_mem(host_register[i], offset_of(&emu->register_file[i]));
+        }
+    }
+}
+
+bool Jit::compile_op(const Op& op, uint16_t address, uint16_t next) {
+    OpKind kind = decode_kind(op.opcode);
+    uint8_t run_next;
+    switch (kind) {
+    case OpKind::LoadImm:
+        emit_mov_imm(RAX, op.NN);
+        emit_store(op.X, RAX);
+        return false;
+    case OpKind::AddImm:
+        emit_load(RAX, op.X);
+        emit8(0x05);
+        emit32(op.NN);
+        emit_zero_extend(RAX);
+        emit_store(op.X, RAX);
+        return false;
+    case OpKind::Move:
+        emit_load(RAX, op.Y);
+        emit_store(op.X, RAX);
+        return false;
+    case OpKind::Or:
+    case OpKind::And:
+    case OpKind::Xor:
+        emit_load(RAX, op.X);
+        emit_load(RCX, op.Y);
+        emit_alu(kind == OpKind::Or ? 0x09 : kind == OpKind::And ? 0x21 : 0x31, RAX, RCX);
+        emit_store(op.X, RAX);
+        return false;
+    case OpKind::AddReg:
+        // The flag compares the registers after the write, exactly like the interpreter
+        emit_load(RAX, op.X);
+        emit_load(RCX, op.Y);
+        emit_alu(0x01, RAX, RCX);
+        emit_zero_extend(RAX);
+        emit_store(op.X, RAX);
+        emit_load(RAX, op.X);
+        emit_load(RCX, op.Y);
+        emit_alu(0x39, RAX, RCX);
+        emit_setcc(CC_B, RDX);
+        emit_store(0xF, RDX);
+        return false;
+    case OpKind::SubReg:
+        emit_load(RDX, op.X);
+        emit_load(RCX, op.Y);
+        emit_mov(RAX, RDX);
+        emit_alu(0x29, RAX, RCX);
+        emit_zero_extend(RAX);
+        emit_store(op.X, RAX);
+        emit_load(RAX, op.X);
+        emit_alu(0x39, RAX, RDX);
+        emit_setcc(CC_BE, RAX);
+        emit_store(0xF, RAX);
+        return false;
+    case OpKind::SubnReg:
+        emit_load(RDX, op.Y);
+        emit_load(RAX, op.X);
+        emit_alu(0x29, RDX, RAX);
+        emit_zero_extend(RDX);
+        emit_store(op.X, RDX);
+        emit_load(RAX, op.X);
+        emit_load(RCX, op.Y);
+        emit_alu(0x39, RAX, RCX);
+        emit_setcc(CC_BE, RAX);
+        emit_store(0xF, RAX);
+        return false;
+    case OpKind::ShiftRight:
+        emit_load(RCX, op.Y);
+        emit_mov(RDX, RCX);
+        emit8(0x83);    // and edx, 1
+        emit8(0xE2);
+        emit8(0x01);
+        emit_mov(RAX, RCX);
+        emit8(0xD1);    // shr eax, 1
+        emit8(0xE8);
+        emit_store(op.X, RAX);
+        emit_store(0xF, RDX);
+        return false;
+    case OpKind::ShiftLeft:
+        emit_load(RCX, op.Y);
+        emit_mov(RDX, RCX);
+        emit8(0xC1);    // shr edx, 7
+        emit8(0xEA);
+        emit8(0x07);
+        emit_mov(RAX, RCX);
+        emit8(0xD1);    // shl eax, 1
+        emit8(0xE0);
+        emit_zero_extend(RAX);
+        emit_store(op.X, RAX);
+        emit_store(0xF, RDX);
+        return false;
+    case OpKind::LoadI:
+        // mov word [rbx + i_register], NNN
+        emit8(0x66);
+        emit8(0xC7);
+        emit_mem(0, offset_of(&emu->i_register));
+        emit16(op.NNN);
+        return false;
+    case OpKind::AddI:
+        // add word [rbx + i_register], ax
+        emit_load(RAX, op.X);
+        emit8(0x66);
+        emit8(0x01);
+        emit_mem(RAX, offset_of(&emu->i_register));
+        return false;
+    case OpKind::Jump:
+        emit_set_pc(op.NNN);
+        return true;
+    case OpKind::JumpV0:
+        // mov word [rbx + program_counter], ax
+        emit_load(RAX, 0x0);
+        emit8(0x05);
+        emit32(op.NNN);
+        emit8(0x66);
+        emit8(0x89);
+        emit_mem(RAX, offset_of(&emu->program_counter));
+        return true;
+    case OpKind::Call:
+        // stack[stack_pointer++] = next
+        emit8(0x0F);    // movzx eax, byte [rbx + stack_pointer]
+        emit8(0xB6);
+        emit_mem(RAX, offset_of(&emu->stack_pointer));
+        emit8(0x66);    // mov word [rbx + rax * 2 + stack], next
+        emit8(0xC7);
+        emit8(0x84);
+        emit8(0x43);
+        emit32(offset_of(&emu->stack[0]));
+        emit16(next);
+        emit8(0xFE);    // inc byte [rbx + stack_pointer]
+        emit_mem(0, offset_of(&emu->stack_pointer));
+        emit_set_pc(op.NNN);
+        return true;
+    case OpKind::SkipEqImm:
+    case OpKind::SkipNeImm:
+        emit_load(RAX, op.X);
+        emit8(0x3D);    // cmp eax, NN
+        emit32(op.NN);
+        run_next = kind == OpKind::SkipEqImm ? CC_NE : CC_E;
+        break;
+    case OpKind::SkipEqReg:
+    case OpKind::SkipNeReg:
+        emit_load(RAX, op.X);
+        emit_load(RCX, op.Y);
+        emit_alu(0x39, RAX, RCX);
+        run_next = kind == OpKind::SkipEqReg ? CC_NE : CC_E;
+        break;
+    default: {
+        // No native translation, call the handler the interpreter would use. The PC is where execute
+        // leaves it, F000 reads its operand there and steps over it itself.
+        emit_set_pc(kind == OpKind::LoadLongI ? address + 2 : next);
+        spill();
+        emit_call((const void*)op.handler, &op, false);
+        reload();
+        return BlockCache::ends_block(kind);
+    }
+    }
+
+    // Skips, the flags hold the comparison. Skipping steps over the 4 byte F000 as a whole.
+    emit_set_pc(next);
+    size_t not_taken = emit_jump(run_next);
+    emit8(0x66);    // cmp word [rbx + memory + next], 0x00F0
+    emit8(0x81);
+    emit_mem(7, offset_of(&emu->memory[next]));
+    emit16(0x00F0);
+    size_t short_skip = emit_jump(CC_NE);
+    emit_set_pc(next + 4);
+    size_t done = emit_jump(CC_ALWAYS);
+    patch_jump(short_skip);
+    emit_set_pc(next + 2);
+    patch_jump(not_taken);
+    patch_jump(done);
+    return true;
+}
+
+bool Jit::compile(Emulator& emulator, Block& block, BlockCache& cache) {
+#if JIT_SUPPORTED
+    if (unavailable)
+        return false;
+    if (!code) {
+#ifdef _WIN32
+        code = (uint8_t*)VirtualAlloc(nullptr, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+        void* mapping = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        code = mapping == MAP_FAILED ? nullptr : (uint8_t*)mapping;
+#endif
+        if (!code) {
+            unavailable = true;
+            return false;
+        }
+    }
+    // Generous upper bound on the ops and code for one block
+    if (JIT_CODE_SIZE - used < BLOCK_MAX_OPS * (sizeof(Op) + 256) + 256)
+        reset(cache);
+
+    emu = &emulator;
+    dirty = 0;
+
+    // The handlers get copies that live as long as the code, a store may free the block while it runs
+    used = (used + 15) & ~(size_t)15;
+    Op* ops = (Op*)(code + used);
+    memcpy(ops, block.ops, block.length * sizeof(Op));
+    used += block.length * sizeof(Op);
+    used = (used + 15) & ~(size_t)15;
+    size_t entry = used;
+
+    // Pin the most used registers of the natively translated ops
+    uint32_t uses[16] = {};
+    for (uint8_t i = 0; i < block.length; i++) {
+        switch (decode_kind(ops[i].opcode)) {
+        case OpKind::AddReg:
+        case OpKind::SubReg:
+        case OpKind::SubnReg:
+        case OpKind::ShiftRight:
+        case OpKind::ShiftLeft:
+            uses[0xF]++;
+            // fallthrough
+        case OpKind::Move:
+        case OpKind::Or:
+        case OpKind::And:
+        case OpKind::Xor:
+        case OpKind::SkipEqReg:
+        case OpKind::SkipNeReg:
+            uses[ops[i].Y]++;
+            // fallthrough
+        case OpKind::LoadImm:
+        case OpKind::AddImm:
+        case OpKind::AddI:
+        case OpKind::SkipEqImm:
+        case OpKind::SkipNeImm:
+            uses[ops[i].X]++;
+            break;
+        default:
+            break;
+        }
+    }
+    memset(host_register, -1, sizeof(host_register));
+    for (int pinned : pinned_registers) {
+        int best = -1;
+        for (int i = 0; i < 16; i++) {
+            if (host_register[i] < 0 && uses[i] >= 2 && (best < 0 || uses[i] > uses[best]))
+                best = i;
+        }
+        if (best < 0)
+            break;
+        host_register[best] = pinned;
+    }
+
+    // Prologue: save rbx, rbp and r12-r15, keep rsp 16 byte aligned with Windows shadow space
+    emit8(0x53);
+    emit8(0x55);
+    emit8(0x41); emit8(0x54);
+    emit8(0x41); emit8(0x55);
+    emit8(0x41); emit8(0x56);
+    emit8(0x41); emit8(0x57);
+    emit8(0x48); emit8(0x83); emit8(0xEC); emit8(40);
+#ifdef _WIN32
+    emit8(0x48); emit8(0x89); emit8(0xCB);  // mov rbx, rcx
+#else
+    emit8(0x48); emit8(0x89); emit8(0xFB);  // mov rbx, rdi
+#endif
+    reload();
+
+    uint16_t address = block.start;
+    bool terminated = false;
+    for (uint8_t i = 0; i < block.length; i++) {
+        uint16_t next = address + (decode_kind(ops[i].opcode) == OpKind::LoadLongI ? 4 : 2);
+        terminated = compile_op(ops[i], address, next);
+        address = next;
+    }
+    if (!terminated)
+        emit_set_pc(block.end);
+
+    // Epilogue
+    spill();
+    emit8(0x48); emit8(0x83); emit8(0xC4); emit8(40);
+    emit8(0x41); emit8(0x5F);
+    emit8(0x41); emit8(0x5E);
+    emit8(0x41); emit8(0x5D);
+    emit8(0x41); emit8(0x5C);
+    emit8(0x5D);
+    emit8(0x5B);
+    emit8(0xC3);
+
+    block.native = code + entry;
+    return true;
+#else
+    (void)emulator;
+    (void)block;
+    (void)cache;
+    return false;
+#endif
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "BlockCache.h"
+
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+#define JIT_HOT_THRESHOLD 16
+#define JIT_CODE_SIZE (1 << 20)
+#define JIT_CACHED_REGISTERS 5
+
+class Emulator;
+typedef void (*JitBlockFn)(Emulator* emu);
+
+// Translates hot blocks from the BlockCache into x86-64 code. Compiled code runs with the Emulator in
+// rbx and up to JIT_CACHED_REGISTERS of the V registers pinned in callee saved host registers. Anything
+// without a native translation calls back into the opcode's handler, so draws still go through op_draw
+// and the bitboard draw_rows / draw_lores_rows, and scrolls through the selected scroll kernel.
+class Jit
+{
+private:
+    uint8_t* code{ nullptr };
+    size_t used{ 0 };
+    bool unavailable{ false };
+
+    // Per block compile state
+    Emulator* emu{ nullptr };
+    int8_t host_register[16];
+    uint16_t dirty{ 0 };
+
+    int32_t offset_of(const void* field) const;
+    void emit8(uint8_t value);
+    void emit16(uint16_t value);
+    void emit32(uint32_t value);
+    void emit64(uint64_t value);
+    void emit_rex(bool wide, int reg, int rm);
+    void emit_rm(int opcode, int reg, int rm);
+    void emit_mem(int reg, int32_t displacement);
+    void emit_mov(int dst, int src);
+    void emit_alu(uint8_t opcode, int dst, int src);
+    void emit_mov_imm(int dst, uint32_t value);
+    void emit_zero_extend(int reg);
+    void emit_setcc(uint8_t condition, int reg);
+    void emit_load(int dst, uint8_t index);
+    void emit_store(uint8_t index, int src);
+    void emit_set_pc(uint16_t address);
+    size_t emit_jump(uint8_t condition);
+    void patch_jump(size_t at);
+    void emit_call(const void* function, const void* argument, bool immediate);
+    void spill();
+    void reload();
+    bool compile_op(const Op& op, uint16_t address, uint16_t next);
+public:
+    Jit() = default;
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+    ~Jit();
+
+    // Returns false if no code could be generated, the block then stays on the block cache path
+    bool compile(Emulator& emulator, Block& block, BlockCache& cache);
+    void reset(BlockCache& cache);
+};
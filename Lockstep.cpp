@@ -0,0 +1,283 @@
+#include "Lockstep.h"
+
+#include <cstring>
+
+#define FOR_LANES for (int l = 0; l < LANES; l++)
+
+static uint16_t fetch(const uint8_t* memory, uint16_t address) {
+    return (memory[address] << 8) | memory[(uint16_t)(address + 1)];
+}
+
+// Bytes a taken skip at next moves over, F000 NNNN counts as one instruction
+static uint16_t skip_size(const uint8_t* memory, uint16_t next) {
+    return fetch(memory, next) == 0xF000 ? 4 : 2;
+}
+
+template <int LANES>
+Lockstep<LANES>::Lockstep(const uint8_t* rom, uint32_t rom_size) : display(128 * 64) {
+    for (int l = 0; l < LANES; l++) {
+        lanes[l] = std::make_unique<Emulator>(display.data());
+        lanes[l]->load_rom(rom, rom_size);
+        lanes[l]->set_engine(Engine::Interpreter);
+        wrote_memory[l] = false;
+    }
+}
+
+template <int LANES>
+void Lockstep<LANES>::gather() {
+    FOR_LANES {
+        const Emulator& emulator = *lanes[l];
+        for (int r = 0; r < 16; r++) {
+            V[r][l] = emulator.register_file[r];
+        }
+        I[l] = emulator.i_register;
+        PC[l] = emulator.program_counter;
+        delay[l] = emulator.delay_timer;
+        sound[l] = emulator.sound_timer;
+    }
+}
+
+template <int LANES>
+void Lockstep<LANES>::scatter() {
+    FOR_LANES {
+        Emulator& emulator = *lanes[l];
+        for (int r = 0; r < 16; r++) {
+            emulator.register_file[r] = V[r][l];
+        }
+        emulator.i_register = I[l];
+        emulator.program_counter = PC[l];
+        emulator.delay_timer = delay[l];
+        emulator.sound_timer = sound[l];
+    }
+}
+
+template <int LANES>
+void Lockstep<LANES>::run_handler(int l, const Op& op) {
+    Emulator& emulator = *lanes[l];
+    for (int r = 0; r < 16; r++) {
+        emulator.register_file[r] = V[r][l];
+    }
+    emulator.i_register = I[l];
+    emulator.program_counter = PC[l];
+    op.handler(emulator, op);
+    for (int r = 0; r < 16; r++) {
+        V[r][l] = emulator.register_file[r];
+    }
+    I[l] = emulator.i_register;
+    PC[l] = emulator.program_counter;
+
+    OpKind kind = decode_kind(op.opcode);
+    if (kind == OpKind::Bcd || kind == OpKind::Store || kind == OpKind::SaveRange) {
+        wrote_memory[l] = true;
+        any_wrote = true;
+    }
+    // The caller counts this instruction, nothing after it runs
+    if (emulator.paused) {
+        budget[l] -= left[l] - 1;
+        left[l] = 1;
+    }
+}
+
+template <int LANES>
+void Lockstep<LANES>::run_cycles(uint32_t count) {
+    gather();
+    FOR_LANES {
+        left[l] = lanes[l]->paused ? 0 : count;
+        budget[l] = left[l];
+    }
+
+    for (;;) {
+        // The lowest PC with work left, lanes that fell behind catch up before the rest moves on
+        uint32_t pc = 0x10000;
+        FOR_LANES {
+            uint32_t lane_pc = left[l] ? PC[l] : 0x10000;
+            pc = lane_pc < pc ? lane_pc : pc;
+        }
+        if (pc == 0x10000)
+            break;
+        int leader = 0;
+        while (!left[leader] || PC[leader] != pc)
+            leader++;
+
+        uint16_t opcode = fetch(lanes[leader]->memory, (uint16_t)pc);
+        uint8_t mask[LANES];
+        FOR_LANES {
+            mask[l] = (left[l] && PC[l] == pc) ? 0xFF : 0;
+        }
+        // Lanes that never stored share the ROM's code, any other lane must be checked against the leader
+        if (any_wrote) {
+            FOR_LANES {
+                if (mask[l] && (wrote_memory[l] || wrote_memory[leader]) && fetch(lanes[l]->memory, (uint16_t)pc) != opcode)
+                    mask[l] = 0;
+            }
+        }
+        FOR_LANES {
+            PC[l] += mask[l] & 2;
+        }
+
+        const Op& op = Emulator::decode_table[opcode];
+        const uint8_t X = op.X;
+        const uint8_t Y = op.Y;
+        uint8_t skip[LANES];
+        bool skips = false;
+        switch (decode_kind(opcode)) {
+        case OpKind::Nop:
+            break;
+        case OpKind::Jump:
+            FOR_LANES { PC[l] = mask[l] ? op.NNN : PC[l]; }
+            break;
+        case OpKind::JumpV0:
+            FOR_LANES { PC[l] = mask[l] ? (uint16_t)(op.NNN + V[0][l]) : PC[l]; }
+            break;
+        case OpKind::Call:
+            FOR_LANES {
+                Emulator& emulator = *lanes[l];
+                if (mask[l] && emulator.stack_pointer < sizeof(emulator.stack) / sizeof(emulator.stack[0])) {
+                    emulator.stack[emulator.stack_pointer++] = PC[l];
+                    PC[l] = op.NNN;
+                }
+            }
+            break;
+        case OpKind::Return:
+            FOR_LANES {
+                Emulator& emulator = *lanes[l];
+                if (mask[l])
+                    PC[l] = emulator.stack[--emulator.stack_pointer];
+            }
+            break;
+        case OpKind::SkipEqImm:
+            FOR_LANES { skip[l] = mask[l] & (V[X][l] == op.NN ? 0xFF : 0); }
+            skips = true;
+            break;
+        case OpKind::SkipNeImm:
+            FOR_LANES { skip[l] = mask[l] & (V[X][l] != op.NN ? 0xFF : 0); }
+            skips = true;
+            break;
+        case OpKind::SkipEqReg:
+            FOR_LANES { skip[l] = mask[l] & (V[X][l] == V[Y][l] ? 0xFF : 0); }
+            skips = true;
+            break;
+        case OpKind::SkipNeReg:
+            FOR_LANES { skip[l] = mask[l] & (V[X][l] != V[Y][l] ? 0xFF : 0); }
+            skips = true;
+            break;
+        // Keys only change between run calls, read straight from each lane
+        case OpKind::SkipKey:
+            FOR_LANES { skip[l] = mask[l] & (lanes[l]->keys[V[X][l]] ? 0xFF : 0); }
+            skips = true;
+            break;
+        case OpKind::SkipNotKey:
+            FOR_LANES { skip[l] = mask[l] & (lanes[l]->keys[V[X][l]] ? 0 : 0xFF); }
+            skips = true;
+            break;
+        case OpKind::LoadImm:
+            FOR_LANES { V[X][l] = mask[l] ? op.NN : V[X][l]; }
+            break;
+        case OpKind::AddImm:
+            FOR_LANES { V[X][l] += mask[l] & op.NN; }
+            break;
+        case OpKind::Move:
+            FOR_LANES { V[X][l] = mask[l] ? V[Y][l] : V[X][l]; }
+            break;
+        case OpKind::Or:
+            FOR_LANES { V[X][l] |= mask[l] & V[Y][l]; }
+            break;
+        case OpKind::And:
+            FOR_LANES { V[X][l] &= ~mask[l] | V[Y][l]; }
+            break;
+        case OpKind::Xor:
+            FOR_LANES { V[X][l] ^= mask[l] & V[Y][l]; }
+            break;
+        // The flag ops follow the Emulator handlers exactly, including X or Y being F and X == Y
+        case OpKind::AddReg:
+            FOR_LANES {
+                uint8_t x = V[X][l], y = V[Y][l];
+                uint8_t result = x + y;
+                uint8_t flag = result < (X == Y ? result : y);
+                V[X][l] = mask[l] ? result : x;
+                V[0xF][l] = mask[l] ? flag : V[0xF][l];
+            }
+            break;
+        case OpKind::SubReg:
+            FOR_LANES {
+                uint8_t x = V[X][l], y = V[Y][l];
+                uint8_t result = x - y;
+                uint8_t flag = result <= x;
+                V[X][l] = mask[l] ? result : x;
+                V[0xF][l] = mask[l] ? flag : V[0xF][l];
+            }
+            break;
+        case OpKind::SubnReg:
+            FOR_LANES {
+                uint8_t x = V[X][l], y = V[Y][l];
+                uint8_t result = y - x;
+                uint8_t flag = result <= (X == Y ? result : y);
+                V[X][l] = mask[l] ? result : x;
+                V[0xF][l] = mask[l] ? flag : V[0xF][l];
+            }
+            break;
+        case OpKind::ShiftRight:
+            FOR_LANES {
+                uint8_t y = V[Y][l];
+                V[X][l] = mask[l] ? (uint8_t)(y >> 1) : V[X][l];
+                V[0xF][l] = mask[l] ? (uint8_t)(y & 0x01) : V[0xF][l];
+            }
+            break;
+        case OpKind::ShiftLeft:
+            FOR_LANES {
+                uint8_t y = V[Y][l];
+                V[X][l] = mask[l] ? (uint8_t)(y << 1) : V[X][l];
+                V[0xF][l] = mask[l] ? (uint8_t)(y >> 7) : V[0xF][l];
+            }
+            break;
+        case OpKind::LoadI:
+            FOR_LANES { I[l] = mask[l] ? op.NNN : I[l]; }
+            break;
+        case OpKind::AddI:
+            FOR_LANES { I[l] += mask[l] & V[X][l]; }
+            break;
+        case OpKind::GetDelay:
+            FOR_LANES { V[X][l] = mask[l] ? delay[l] : V[X][l]; }
+            break;
+        case OpKind::SetDelay:
+            FOR_LANES { delay[l] = mask[l] ? V[X][l] : delay[l]; }
+            break;
+        case OpKind::SetSound:
+            FOR_LANES { sound[l] = mask[l] ? V[X][l] : sound[l]; }
+            break;
+        default:
+            FOR_LANES {
+                if (mask[l])
+                    run_handler(l, op);
+            }
+            break;
+        }
+        if (skips) {
+            uint16_t size = skip_size(lanes[leader]->memory, PC[leader]);
+            FOR_LANES {
+                if (skip[l])
+                    PC[l] += any_wrote && (wrote_memory[l] || wrote_memory[leader]) ? skip_size(lanes[l]->memory, PC[l]) : size;
+            }
+        }
+        FOR_LANES {
+            left[l] -= mask[l] & 1;
+        }
+    }
+
+    scatter();
+    FOR_LANES {
+        lanes[l]->instruction_count += budget[l] - left[l];
+    }
+}
+
+template <int LANES>
+void Lockstep<LANES>::run_frame() {
+    run_cycles(cycles_per_frame);
+    FOR_LANES {
+        lanes[l]->tick_timers();
+    }
+}
+
+template class Lockstep<8>;
+template class Lockstep<16>;
+template class Lockstep<32>;
@@ -0,0 +1,50 @@
+#pragma once
+#include "Emulator.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Runs LANES copies of one ROM together. Registers, I, PCs and timers of all lanes are kept in
+// structure of arrays form. Each step picks the lowest PC among the lanes with instructions left and
+// executes that opcode for every lane sitting on it. ALU ops, loads, skips, jumps and timer ops run as
+// plain loops over the lanes, which the compiler vectorizes, with lanes at other PCs masked out. Lanes
+// that went their own way are picked up again once they become the lowest PC, and loops usually bring
+// them back together. Key skips read each lane's keys directly. Everything else (drawing, memory)
+// runs through the regular Emulator handler of each lane.
+//
+// Each lane is a full Emulator, which holds the authoritative state between run calls, so keys,
+// copy_state and read_planes work on lane(i) as usual. Every lane executes exactly the instructions it
+// would on its own.
+template <int LANES>
+class Lockstep
+{
+private:
+    std::vector<Color> display;     // Shared and never synced
+    std::unique_ptr<Emulator> lanes[LANES];
+    uint32_t cycles_per_frame{ 10 };
+
+    // Lane state while running, loaded from the Emulators at the start of run_cycles and written back at the end
+    alignas(64) uint8_t V[16][LANES];
+    alignas(64) uint16_t I[LANES];
+    alignas(64) uint16_t PC[LANES];
+    alignas(64) uint8_t delay[LANES];
+    alignas(64) uint8_t sound[LANES];
+    alignas(64) uint32_t left[LANES];           // Instructions still to run in this call
+    alignas(64) uint32_t budget[LANES];         // left at the start, less whatever a pause cut off
+    bool wrote_memory[LANES];                   // Lane has stored to memory, its code may differ from the others
+    bool any_wrote{ false };
+
+    void gather();
+    void scatter();
+    void run_handler(int lane, const Op& op);
+public:
+    explicit Lockstep(const uint8_t* rom, uint32_t rom_size);
+
+    Emulator& lane(int i) { return *lanes[i]; }
+    void set_cycles_per_frame(uint32_t cycles) { cycles_per_frame = cycles; }
+    // Runs count instructions on every lane that is not paused
+    void run_cycles(uint32_t count);
+    // cycles_per_frame instructions on every lane, then one timer tick
+    void run_frame();
+};
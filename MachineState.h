@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+
+#define MEM_SIZE 0x10000
+#define MAX_ROM_SIZE (MEM_SIZE - 0x200)      // ROMs load at 0x200, anything past the end of memory is dropped
+#define DISPLAY_ROW_WORDS 2
+
+// Everything a running program can observe or change, kept in one trivially copyable block so a save state
+// is a plain struct copy. Emulator derives from it, the fields are used by name as before. Caches, the
+// engine, palette and frame rate settings live in Emulator and are not part of a state.
+struct MachineState {
+    // CPU
+    uint8_t register_file[16]{};
+    uint8_t rpl_file[16]{};
+    uint16_t program_counter = 0x0200;
+    uint16_t i_register = 0x0000;
+    uint8_t stack_pointer = 0x00;
+    uint8_t delay_timer = 0;
+    uint8_t sound_timer = 0;
+    bool paused = false;
+    // IO
+    bool keys[16]{};
+    bool waiting_on_release{ false };
+    // Display
+    uint8_t color_plane{ 1 };
+    bool high_resolution{ false };
+    bool lores_native{ true };
+    uint8_t row_base[2]{};                  // Physical row holding screen row 0 of each plane, vertical scrolls only move this
+    // CXNN
+    uint64_t random_state{ 0 };
+    // Since the last load
+    uint32_t unknown_opcode_count{ 0 };
+    uint64_t instruction_count{ 0 };
+    // The loaded ROM, a restored state may come from another one
+    uint32_t rom_size = 0;
+    uint64_t rom_hash = 0;
+
+    // Two 64 bit words per 128 pixel row, the most significant bit of word 0 is the leftmost pixel
+    uint64_t display_bitmap[2][64][DISPLAY_ROW_WORDS];
+    // Native 64x32 planes, one word per row. Used instead of display_bitmap while lores_native is set, which is
+    // low resolution mode as long as nothing forced the screen into 2x2 doubled high resolution pixels.
+    uint64_t lores_bitmap[2][32];
+    uint16_t stack[0x1000];
+    uint8_t memory[MEM_SIZE];
+};
+
+static_assert(std::is_trivially_copyable<MachineState>::value, "MachineState must stay a plain copy");
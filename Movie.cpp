@@ -0,0 +1,196 @@
+#include "Movie.h"
+#include "Rewind.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+static void put_varint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static void put_le(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+// Reads from a loaded file, every read fails once the data runs out
+struct Reader {
+    const uint8_t* data;
+    const uint8_t* end;
+
+    bool le(uint64_t& value, int bytes) {
+        if (end - data < bytes)
+            return false;
+        value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value |= (uint64_t)*data++ << (8 * i);
+        }
+        return true;
+    }
+    bool varint(uint32_t& value) {
+        value = 0;
+        for (int shift = 0; data < end && shift < 32; shift += 7) {
+            uint8_t byte = *data++;
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+};
+
+bool MovieRecorder::start(const char* path, const Emulator& emulator) {
+    stop();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cout << "Can't write movie " << path << std::endl;
+        return false;
+    }
+    auto state = std::make_unique<MachineState>();
+    emulator.save_state(*state);
+    std::vector<uint8_t> encoded;
+    Rewind::encode((const uint8_t*)state.get(), Rewind::zero_state, sizeof(MachineState), encoded);
+
+    std::vector<uint8_t> header(MOVIE_MAGIC, MOVIE_MAGIC + 8);
+    put_le(header, MOVIE_VERSION, 4);
+    put_le(header, sizeof(MachineState), 4);
+    put_le(header, state->rom_hash, 8);
+    put_le(header, emulator.get_cycles_per_frame(), 4);
+    put_le(header, encoded.size(), 4);
+    header.insert(header.end(), encoded.begin(), encoded.end());
+
+    pending = std::move(header);
+    stopping = false;
+    run = { 0, 0 };
+    frame_count = 0;
+    active = true;
+    writer = std::thread(&MovieRecorder::write_loop, this);
+    return true;
+}
+
+void MovieRecorder::write_loop() {
+    std::vector<uint8_t> batch;
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [this] { return stopping || !pending.empty(); });
+        batch.swap(pending);
+        bool last = stopping;
+        guard.unlock();
+        file.write((const char*)batch.data(), batch.size());
+        file.flush();
+        batch.clear();
+        guard.lock();
+        if (last && pending.empty())
+            return;
+    }
+}
+
+void MovieRecorder::queue_run() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        put_varint(pending, run.frames);
+        put_le(pending, run.keys, 2);
+    }
+    wake.notify_one();
+}
+
+void MovieRecorder::record(uint16_t keys) {
+    if (!active)
+        return;
+    if (run.frames && (keys != run.keys || run.frames >= MOVIE_MAX_RUN)) {
+        queue_run();
+        run.frames = 0;
+    }
+    run.keys = keys;
+    run.frames++;
+    frame_count++;
+}
+
+void MovieRecorder::stop() {
+    if (!active)
+        return;
+    if (run.frames)
+        queue_run();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    file.close();
+    active = false;
+}
+
+bool Movie::load(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Can't read movie " << path << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Reader reader{ bytes.data(), bytes.data() + bytes.size() };
+
+    uint64_t version, state_size, cycles, encoded_size;
+    if (bytes.size() < 8 || memcmp(bytes.data(), MOVIE_MAGIC, 8) != 0) {
+        std::cout << path << " is not a movie" << std::endl;
+        return false;
+    }
+    reader.data += 8;
+    if (!reader.le(version, 4) || !reader.le(state_size, 4) || !reader.le(rom_hash, 8) || !reader.le(cycles, 4) || !reader.le(encoded_size, 4) ||
+        encoded_size > (uint64_t)(reader.end - reader.data)) {
+        std::cout << "Movie " << path << " is truncated" << std::endl;
+        return false;
+    }
+    if (version != MOVIE_VERSION || state_size != sizeof(MachineState)) {
+        std::cout << "Movie " << path << " was recorded by an incompatible build" << std::endl;
+        return false;
+    }
+    initial = std::make_unique<MachineState>();
+    if (!Rewind::decode(reader.data, encoded_size, Rewind::zero_state, (uint8_t*)initial.get(), sizeof(MachineState)) ||
+        cycles == 0 || cycles > MAX_CYCLES_PER_FRAME) {
+        std::cout << "Movie " << path << " is damaged" << std::endl;
+        return false;
+    }
+    reader.data += encoded_size;
+    cycles_per_frame = (uint32_t)cycles;
+
+    // A recording cut short ends in a partial run, which is dropped
+    runs.clear();
+    frame_count = 0;
+    uint32_t frames;
+    uint64_t keys;
+    while (reader.varint(frames) && reader.le(keys, 2)) {
+        runs.push_back({ frames, (uint16_t)keys });
+        frame_count += frames;
+    }
+    run_index = 0;
+    run_used = 0;
+    return true;
+}
+
+void Movie::start(Emulator& emulator) {
+    emulator.load_state(*initial);
+    emulator.set_cycles_per_frame(cycles_per_frame);
+    run_index = 0;
+    run_used = 0;
+}
+
+bool Movie::play_frame(Emulator& emulator) {
+    while (run_index < runs.size() && run_used >= runs[run_index].frames) {
+        run_index++;
+        run_used = 0;
+    }
+    if (run_index == runs.size())
+        return false;
+    run_used++;
+    emulator.set_paused(false);
+    emulator.set_keys(runs[run_index].keys);
+    emulator.run_frame();
+    return true;
+}
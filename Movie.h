@@ -0,0 +1,84 @@
+#pragma once
+#include "Emulator.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define MOVIE_MAGIC "CH8MOVIE"
+#define MOVIE_VERSION 1
+#define MOVIE_MAX_RUN 600       // Frames, a run is written out at least this often so a crash loses little
+
+// Input movies: the machine state a recording started from plus the key mask of every frame after it.
+// Replaying one reproduces the session exactly, CXNN included, since its generator is part of the state.
+//
+// File layout, little endian:
+//   "CH8MOVIE", u32 version, u32 sizeof(MachineState), u64 ROM hash, u32 cycles per frame,
+//   u32 encoded state size, the initial state encoded with Rewind::encode against zeros,
+//   then runs of (varint frame count, u16 key mask) up to the end of the file.
+// The state is stored as is, so movies only replay on builds with the same MachineState layout.
+
+struct KeyRun {
+    uint32_t frames;
+    uint16_t keys;
+};
+
+// Records a movie from the frame loop. Runs are handed to a writer thread, record only appends to a buffer.
+class MovieRecorder
+{
+private:
+    std::ofstream file;
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<uint8_t> pending;       // Bytes for the writer, guarded by lock
+    bool stopping{ false };
+    bool active{ false };
+    KeyRun run{ 0, 0 };
+    uint64_t frame_count{ 0 };
+
+    void write_loop();
+    void queue(const std::vector<uint8_t>& bytes);
+    void queue_run();
+public:
+    MovieRecorder() = default;
+    MovieRecorder(const MovieRecorder&) = delete;
+    MovieRecorder& operator=(const MovieRecorder&) = delete;
+    ~MovieRecorder() { stop(); }
+
+    // Starts a movie from the emulator's current state and cycles_per_frame. False if path can't be written.
+    bool start(const char* path, const Emulator& emulator);
+    // Once per frame run, with the keys it runs with. Single steps while paused can't be recorded.
+    void record(uint16_t keys);
+    // Writes the last run and waits for the writer to finish the file
+    void stop();
+    bool recording() const { return active; }
+    uint64_t frames() const { return frame_count; }
+};
+
+// A movie read back for replay
+class Movie
+{
+private:
+    std::unique_ptr<MachineState> initial;
+    std::vector<KeyRun> runs;
+    size_t run_index{ 0 };
+    uint32_t run_used{ 0 };
+    uint64_t frame_count{ 0 };
+public:
+    uint64_t rom_hash{ 0 };
+    uint32_t cycles_per_frame{ 0 };
+
+    // False, with the reason on cout, if the file is missing, damaged or from another build
+    bool load(const char* path);
+    // Puts the emulator in the movie's initial state with its cycles_per_frame and rewinds playback
+    void start(Emulator& emulator);
+    // Runs the next frame with its recorded keys, false once the movie has ended. Frames are only
+    // recorded while running, so each one starts unpaused even if the ROM exited during the last.
+    bool play_frame(Emulator& emulator);
+    uint64_t frames() const { return frame_count; }
+};
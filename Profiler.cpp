@@ -0,0 +1,50 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+Profiler::Profiler() {
+    clock_overhead = UINT64_MAX;
+    for (int i = 0; i < 64; i++) {
+        uint64_t start = profile_clock();
+        uint64_t elapsed = profile_clock() - start;
+        clock_overhead = std::min(clock_overhead, elapsed);
+    }
+}
+
+void Profiler::clear() {
+    memset(executions, 0, sizeof(executions));
+    memset(kind_executions, 0, sizeof(kind_executions));
+    memset(ticks, 0, sizeof(ticks));
+    memset(samples, 0, sizeof(samples));
+    total_ticks = 0;
+    total_ns = 0;
+}
+
+uint64_t Profiler::total_executions() const {
+    uint64_t total = 0;
+    for (uint64_t count : kind_executions) {
+        total += count;
+    }
+    return total;
+}
+
+double Profiler::kind_ns(OpKind kind) const {
+    if (!total_ticks || !samples[(int)kind])
+        return 0;
+    return ticks[(int)kind] * (total_ns / total_ticks) / samples[(int)kind];
+}
+
+void Profiler::hotspots(size_t count, std::vector<Hotspot>& out) const {
+    out.clear();
+    // Only the few addresses holding code are non zero
+    for (uint32_t address = 0; address < MEM_SIZE; address++) {
+        if (executions[address])
+            out.push_back({ (uint16_t)address, executions[address] });
+    }
+    count = std::min(count, out.size());
+    std::partial_sort(out.begin(), out.begin() + count, out.end(), [](const Hotspot& a, const Hotspot& b) {
+        return a.executions > b.executions || (a.executions == b.executions && a.address < b.address);
+    });
+    out.resize(count);
+}
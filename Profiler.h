@@ -0,0 +1,87 @@
+#pragma once
+#include "Decoder.h"
+#include "MachineState.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILE_TSC 1
+#else
+#define PROFILE_TSC 0
+#endif
+
+// Cheapest clock there is, in its own ticks. Converted to nanoseconds against steady_clock per run.
+inline uint64_t profile_clock() {
+#if PROFILE_TSC
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct Hotspot {
+    uint16_t address;
+    uint64_t executions;
+};
+
+#define PROFILE_SAMPLE_MEAN 16    // Instructions per timed one, on average
+
+// Execution profile: how often each address was executed from, in a flat array indexed by the program
+// counter, and the host time taken by each kind of instruction. Every execution is counted, but reading
+// the clock costs as much as a simple instruction, so only about one in PROFILE_SAMPLE_MEAN is timed, at
+// random intervals so loops don't alias with the sampling. Profiled instructions run on the interpreter,
+// the times are of its handlers.
+class Profiler
+{
+private:
+    uint64_t ticks[(int)OpKind::Count]{};
+    uint64_t samples[(int)OpKind::Count]{};
+    uint32_t countdown{ 1 };
+    uint32_t sample_state{ 0x9E3779B9 };
+    uint64_t clock_overhead;            // Ticks between two back to back clock reads
+    uint64_t total_ticks{ 0 };
+    double total_ns{ 0 };
+public:
+    uint64_t executions[MEM_SIZE]{};
+    uint64_t kind_executions[(int)OpKind::Count]{};
+
+    Profiler();
+    void count(uint16_t pc, uint16_t opcode) {
+        executions[pc]++;
+        kind_executions[(int)decode_kind(opcode)]++;
+    }
+    // True when the next instruction should be timed
+    bool sample() {
+        if (--countdown)
+            return false;
+        sample_state ^= sample_state << 13;
+        sample_state ^= sample_state >> 17;
+        sample_state ^= sample_state << 5;
+        countdown = 1 + (sample_state & (2 * PROFILE_SAMPLE_MEAN - 1));
+        return true;
+    }
+    void add_sample(uint16_t opcode, uint64_t elapsed) {
+        int kind = (int)decode_kind(opcode);
+        ticks[kind] += elapsed > clock_overhead ? elapsed - clock_overhead : 0;
+        samples[kind]++;
+    }
+    // Wall time of a whole profiled run, calibrates the ticks
+    void add_run(uint64_t elapsed_ticks, double elapsed_ns) {
+        total_ticks += elapsed_ticks;
+        total_ns += elapsed_ns;
+    }
+    void clear();
+
+    uint64_t total_executions() const;
+    // Average host time of one instruction of kind, 0 until one was timed
+    double kind_ns(OpKind kind) const;
+    // The count addresses executed most often, most first
+    void hotspots(size_t count, std::vector<Hotspot>& out) const;
+};
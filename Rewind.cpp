@@ -0,0 +1,174 @@
+#include "Rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Keyframes are encoded against this
+const uint8_t Rewind::zero_state[sizeof(MachineState)] = {};
+
+static uint64_t load_word(const uint8_t* bytes) {
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+static void put_varint(std::vector<uint8_t>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static bool get_varint(const uint8_t*& data, const uint8_t* end, size_t& value) {
+    value = 0;
+    for (int shift = 0; data < end && shift < 64; shift += 7) {
+        uint8_t byte = *data++;
+        value |= (size_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+Rewind::Rewind(size_t capacity) : base(std::make_unique<MachineState>()), current(std::make_unique<MachineState>()) {
+    // An encoded state is at most a few bytes larger than the state itself
+    buffer.resize(std::max(capacity, sizeof(MachineState) + 64));
+    scratch.reserve(sizeof(MachineState) * 2);
+}
+
+// Records are a varint count of equal bytes to skip, a varint count of differing bytes and their XOR
+// with the reference. Equal bytes at the end need no record.
+void Rewind::encode(const uint8_t* state, const uint8_t* reference, size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < size) {
+        size_t start = i;
+        while (i + 8 <= size && load_word(state + i) == load_word(reference + i))
+            i += 8;
+        while (i < size && state[i] == reference[i])
+            i++;
+        if (i == size)
+            break;
+        put_varint(out, i - start);
+
+        // A differing run ends at 8 equal bytes, shorter gaps cost less as part of it
+        size_t literal = i;
+        size_t equal = 0;
+        while (i < size && equal < 8) {
+            equal = state[i] == reference[i] ? equal + 1 : 0;
+            i++;
+        }
+        i -= equal;
+        put_varint(out, i - literal);
+        for (size_t j = literal; j < i; j++) {
+            out.push_back(state[j] ^ reference[j]);
+        }
+    }
+}
+
+bool Rewind::decode(const uint8_t* data, size_t data_size, const uint8_t* reference, uint8_t* state, size_t size) {
+    memcpy(state, reference, size);
+    const uint8_t* end = data + data_size;
+    size_t position = 0;
+    while (data < end) {
+        size_t skip, length;
+        if (!get_varint(data, end, skip) || !get_varint(data, end, length))
+            return false;
+        if (skip > size - position || length > size - position - skip || length > (size_t)(end - data))
+            return false;
+        position += skip;
+        for (size_t j = 0; j < length; j++) {
+            state[position + j] ^= data[j];
+        }
+        data += length;
+        position += length;
+    }
+    return true;
+}
+
+bool Rewind::load_base() {
+    auto keyframe = std::find_if(entries.rbegin(), entries.rend(), [](const Entry& entry) { return entry.keyframe; });
+    if (keyframe == entries.rend())
+        return false;
+    if (base_id != keyframe->id) {
+        decode(&buffer[keyframe->offset], keyframe->size, zero_state, (uint8_t*)base.get(), sizeof(MachineState));
+        base_id = keyframe->id;
+    }
+    return true;
+}
+
+void Rewind::store(const std::vector<uint8_t>& data, bool keyframe) {
+    size_t size = data.size();
+    size_t offset = entries.empty() ? 0 : entries.back().offset + entries.back().size;
+    if (offset + size > buffer.size())
+        offset = 0;
+    // Make room a whole group at a time, the deltas are useless without their keyframe
+    while (!entries.empty() && entries.front().offset < offset + size && offset < entries.front().offset + entries.front().size) {
+        do {
+            entries.pop_front();
+        } while (!entries.empty() && !entries.front().keyframe);
+    }
+    if (size)
+        memcpy(&buffer[offset], data.data(), size);
+    entries.push_back({ offset, size, next_id++, keyframe });
+}
+
+void Rewind::capture(const Emulator& emulator) {
+    emulator.save_state(*current);
+    bool keyframe = since_keyframe >= REWIND_KEYFRAME_INTERVAL || !load_base();
+    encode((const uint8_t*)current.get(), keyframe ? zero_state : (const uint8_t*)base.get(), sizeof(MachineState), scratch);
+    store(scratch, keyframe);
+    if (!entries.front().keyframe) {
+        // Making room took this frame's own keyframe, the buffer is too small for a whole group
+        entries.clear();
+        encode((const uint8_t*)current.get(), zero_state, sizeof(MachineState), scratch);
+        store(scratch, true);
+        keyframe = true;
+    }
+    if (keyframe) {
+        *base = *current;
+        base_id = entries.back().id;
+        since_keyframe = 1;
+    }
+    else {
+        since_keyframe++;
+    }
+}
+
+bool Rewind::step_back(Emulator& emulator) {
+    if (entries.empty())
+        return false;
+    Entry entry = entries.back();
+    if (entry.keyframe)
+        decode(&buffer[entry.offset], entry.size, zero_state, (uint8_t*)current.get(), sizeof(MachineState));
+    else {
+        load_base();
+        decode(&buffer[entry.offset], entry.size, (const uint8_t*)base.get(), (uint8_t*)current.get(), sizeof(MachineState));
+    }
+    emulator.load_state(*current);
+    entries.pop_back();
+
+    if (entry.keyframe) {
+        auto keyframe = std::find_if(entries.rbegin(), entries.rend(), [](const Entry& entry) { return entry.keyframe; });
+        since_keyframe = (uint32_t)(keyframe - entries.rbegin()) + 1;
+    }
+    else {
+        since_keyframe--;
+    }
+    return true;
+}
+
+void Rewind::clear() {
+    entries.clear();
+    since_keyframe = 0;
+    base_id = UINT64_MAX;
+}
+
+size_t Rewind::used() const {
+    if (entries.empty())
+        return 0;
+    size_t start = entries.front().offset;
+    size_t end = entries.back().offset + entries.back().size;
+    return end >= start ? end - start : buffer.size() - start + end;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "Emulator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#define REWIND_DEFAULT_BYTES (32u << 20)
+#define REWIND_KEYFRAME_INTERVAL 60         // Frames per keyframe, one second
+
+// Rewind history: a ring buffer of per frame save states. Every REWIND_KEYFRAME_INTERVAL frames a
+// keyframe is stored, the frames in between are stored as the XOR of their state with that keyframe. Both
+// are run length encoded, which leaves only the bytes that differ, so a frame usually takes a few hundred
+// bytes instead of a whole MachineState. When the buffer is full the oldest keyframe and its frames go.
+class Rewind
+{
+private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+        uint64_t id;
+        bool keyframe;
+    };
+
+    std::vector<uint8_t> buffer;
+    std::deque<Entry> entries;              // Oldest first, always starts with a keyframe
+    uint64_t next_id{ 0 };
+    uint32_t since_keyframe{ 0 };
+    // Decoded keyframe of the newest group of entries, base_id is its entry
+    std::unique_ptr<MachineState> base;
+    uint64_t base_id{ UINT64_MAX };
+    std::unique_ptr<MachineState> current;  // Scratch for capture and step_back
+    std::vector<uint8_t> scratch;
+
+    bool load_base();
+    void store(const std::vector<uint8_t>& data, bool keyframe);
+public:
+    explicit Rewind(size_t capacity = REWIND_DEFAULT_BYTES);
+
+    // Runs of bytes equal to reference are skipped, runs that differ are stored as their XOR with it.
+    // Movies store their initial state this way too, against zero_state.
+    static void encode(const uint8_t* state, const uint8_t* reference, size_t size, std::vector<uint8_t>& out);
+    // False if data is malformed, state is then garbage
+    static bool decode(const uint8_t* data, size_t data_size, const uint8_t* reference, uint8_t* state, size_t size);
+    static const uint8_t zero_state[sizeof(MachineState)];
+
+    // Records the emulator's state as the newest frame of history
+    void capture(const Emulator& emulator);
+    // Loads the newest frame into the emulator and drops it from history. False once history is empty.
+    bool step_back(Emulator& emulator);
+    void clear();
+
+    size_t frames() const { return entries.size(); }
+    // Bytes of the buffer in use
+    size_t used() const;
+    size_t capacity() const { return buffer.size(); }
+};
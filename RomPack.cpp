@@ -0,0 +1,134 @@
+#include "RomPack.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const char* path) {
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(handle, &file_size)) {
+        CloseHandle(handle);
+        return false;
+    }
+    bool mapped = true;
+    if (file_size.QuadPart) {
+        // The view keeps the mapping and file alive once the handles are closed
+        HANDLE section = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        mapping = section ? (const uint8_t*)MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (section)
+            CloseHandle(section);
+        mapped = mapping != nullptr;
+        length = mapped ? (size_t)file_size.QuadPart : 0;
+    }
+    CloseHandle(handle);
+    return mapped;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    bool mapped = true;
+    // mmap refuses empty mappings
+    if (info.st_size) {
+        void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        mapped = address != MAP_FAILED;
+        if (mapped) {
+            mapping = (const uint8_t*)address;
+            length = (size_t)info.st_size;
+        }
+    }
+    ::close(fd);
+    return mapped;
+#endif
+}
+
+void MappedFile::close() {
+    if (mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap((void*)mapping, length);
+#endif
+    }
+    mapping = nullptr;
+    length = 0;
+}
+
+bool RomPack::open(const char* path) {
+    entries = nullptr;
+    count = 0;
+    if (!file.open(path)) {
+        std::cout << "Can't read pack " << path << std::endl;
+        return false;
+    }
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+    uint32_t header[2];
+    if (size < 16 || memcmp(data, ROM_PACK_MAGIC, 8) != 0) {
+        std::cout << path << " is not a ROM pack" << std::endl;
+        file.close();
+        return false;
+    }
+    memcpy(header, data + 8, sizeof(header));
+    if (header[0] != ROM_PACK_VERSION) {
+        std::cout << "ROM pack " << path << " has unsupported version " << header[0] << std::endl;
+        file.close();
+        return false;
+    }
+    // Everything the index points at must be inside the file, the accessors don't check
+    const RomPackEntry* index = (const RomPackEntry*)(data + 16);
+    bool valid = header[1] <= (size - 16) / sizeof(RomPackEntry);
+    for (uint32_t i = 0; valid && i < header[1]; i++) {
+        const RomPackEntry& entry = index[i];
+        valid = entry.offset <= size && entry.size <= size - entry.offset &&
+            entry.name_offset <= size && entry.name_length <= size - entry.name_offset;
+    }
+    if (!valid) {
+        std::cout << "ROM pack " << path << " is damaged" << std::endl;
+        file.close();
+        return false;
+    }
+    entries = index;
+    count = header[1];
+    return true;
+}
+
+std::string RomPack::name(size_t index) const {
+    return std::string((const char*)file.data() + entries[index].name_offset, entries[index].name_length);
+}
+
+long RomPack::find(const char* name) const {
+    size_t length = strlen(name);
+    long low = 0, high = (long)count - 1;
+    while (low <= high) {
+        long middle = (low + high) / 2;
+        const RomPackEntry& entry = entries[middle];
+        int order = memcmp(file.data() + entry.name_offset, name, entry.name_length < length ? entry.name_length : length);
+        if (order == 0)
+            order = entry.name_length < length ? -1 : entry.name_length > length ? 1 : 0;
+        if (order == 0)
+            return middle;
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle - 1;
+    }
+    return -1;
+}
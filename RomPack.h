@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define ROM_PACK_MAGIC "CH8ROMPK"
+#define ROM_PACK_VERSION 1
+#define ROM_PACK_ALIGNMENT 16       // ROM data offsets are multiples of this
+
+// A whole file mapped read only. Loading a ROM from one copies it from the page cache straight into
+// emulator memory, with no read buffer in between.
+class MappedFile
+{
+private:
+    const uint8_t* mapping{ nullptr };
+    size_t length{ 0 };
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    // False if the file can't be opened or mapped. An empty file opens with no data.
+    bool open(const char* path);
+    void close();
+    const uint8_t* data() const { return mapping; }
+    size_t size() const { return length; }
+};
+
+// One ROM in the index of a pack
+struct RomPackEntry {
+    uint64_t hash;          // fnv1a of the ROM as Emulator::load_rom keeps it, same as its rom_hash
+    uint64_t offset;        // From the start of the file
+    uint32_t size;
+    uint32_t name_offset;   // From the start of the file, names are not terminated
+    uint32_t name_length;
+    uint32_t reserved;
+};
+static_assert(sizeof(RomPackEntry) == 32, "RomPackEntry is read from the mapped file as is");
+
+// A ROM library in one file, so a batch run maps one file instead of opening thousands of tiny ones.
+//
+// File layout, little endian:
+//   "CH8ROMPK", u32 version, u32 ROM count, the RomPackEntry index sorted by name, the names,
+//   then the ROMs, each starting on a ROM_PACK_ALIGNMENT boundary.
+// tools/ch8pack writes them. The index is used in place from the mapping.
+class RomPack
+{
+private:
+    MappedFile file;
+    const RomPackEntry* entries{ nullptr };
+    uint32_t count{ 0 };
+public:
+    // False, with the reason on cout, if the file is missing, not a pack or damaged
+    bool open(const char* path);
+    size_t size() const { return count; }
+    std::string name(size_t index) const;
+    const uint8_t* rom(size_t index) const { return file.data() + entries[index].offset; }
+    uint32_t rom_size(size_t index) const { return entries[index].size; }
+    uint64_t rom_hash(size_t index) const { return entries[index].hash; }
+    // Index of the ROM called name, -1 if there is none
+    long find(const char* name) const;
+};
@@ -0,0 +1,48 @@
+#include "SpriteCache.h"
+#include "Emulator.h"
+
+void SpriteCache::expand(const uint8_t* memory, uint16_t address, uint8_t height, bool wide, Sprite& sprite) {
+    sprite.address = address;
+    sprite.height = height;
+    sprite.wide = wide;
+    sprite.valid = true;
+    sprite.rows = 0;
+    for (uint8_t i = 0; i < height; i++) {
+        uint64_t bits;
+        if (wide) {
+            uint16_t left = double_table[memory[(uint16_t)(address + 2 * i)]];
+            uint16_t right = double_table[memory[(uint16_t)(address + 2 * i + 1)]];
+            bits = ((uint64_t)left << 48) | ((uint64_t)right << 32);
+        }
+        else {
+            bits = (uint64_t)double_table[memory[(uint16_t)(address + i)]] << 48;
+        }
+        // Every pixel is two rows tall as well
+        sprite.bits[sprite.rows++] = bits;
+        sprite.bits[sprite.rows++] = bits;
+    }
+}
+
+void SpriteCache::cover(const Sprite& sprite, int delta) {
+    if (coverage.empty())
+        coverage.resize(MEM_SIZE);
+    for (uint16_t i = 0; i < span(sprite); i++) {
+        coverage[(uint16_t)(sprite.address + i)] += delta;
+    }
+}
+
+void SpriteCache::invalidate(uint16_t address) {
+    for (Sprite& sprite : entries) {
+        if (sprite.valid && (uint16_t)(address - sprite.address) < span(sprite)) {
+            cover(sprite, -1);
+            sprite.valid = false;
+        }
+    }
+}
+
+void SpriteCache::clear() {
+    for (Sprite& sprite : entries) {
+        sprite.valid = false;
+    }
+    coverage.clear();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#define SPRITE_CACHE_ENTRIES 64
+#define SPRITE_MAX_ROWS 32
+
+// Each pixel of a byte doubled, most significant bit first
+constexpr std::array<uint16_t, 256> build_double_table() {
+    std::array<uint16_t, 256> table{};
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        uint16_t doubled = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            if (byte & (1u << bit))
+                doubled |= (uint16_t)(3u << (bit * 2));
+        }
+        table[byte] = doubled;
+    }
+    return table;
+}
+constexpr std::array<uint16_t, 256> double_table = build_double_table();
+
+// A low resolution sprite scaled up to high resolution pixels, one row per word with the leftmost pixel
+// in the most significant bit
+struct Sprite {
+    uint16_t address;
+    uint8_t height;     // Rows of sprite data in memory, 16 for a 16x16 sprite
+    bool wide;          // 16x16 sprite, two bytes per row
+    bool valid;
+    uint8_t rows;
+    uint64_t bits[SPRITE_MAX_ROWS];
+};
+
+// Direct mapped cache of doubled low resolution sprites, so redrawing the same sprite every frame skips
+// the expansion. Entries are dropped when memory they were read from is written.
+class SpriteCache
+{
+private:
+    Sprite entries[SPRITE_CACHE_ENTRIES]{};
+    std::vector<uint8_t> coverage;      // Number of cached sprites read from each byte
+
+    static uint16_t span(const Sprite& sprite) { return sprite.wide ? 32 : sprite.height; }
+    void cover(const Sprite& sprite, int delta);
+public:
+    static void expand(const uint8_t* memory, uint16_t address, uint8_t height, bool wide, Sprite& sprite);
+    const Sprite& fetch(const uint8_t* memory, uint16_t address, uint8_t height, bool wide) {
+        Sprite& sprite = entries[(address ^ (address >> 6) ^ height) % SPRITE_CACHE_ENTRIES];
+        if (sprite.valid && sprite.address == address && sprite.height == height && sprite.wide == wide)
+            return sprite;
+        if (sprite.valid)
+            cover(sprite, -1);
+        expand(memory, address, height, wide, sprite);
+        cover(sprite, 1);
+        return sprite;
+    }
+    bool covers(uint16_t address) const { return !coverage.empty() && coverage[address]; }
+    // Drops every sprite that was read from address
+    void invalidate(uint16_t address);
+    void clear();
+};
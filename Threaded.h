@@ -0,0 +1,43 @@
+#pragma once
+#include "Decoder.h"
+
+#include <cstdint>
+#include <vector>
+
+// Labels as values are a GCC/Clang extension, elsewhere the threaded engine falls back to the interpreter
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(EMULATOR_NO_THREADED)
+#define THREADED_SUPPORTED 1
+#else
+#define THREADED_SUPPORTED 0
+#endif
+
+// A predecoded instruction for the threaded engine: the label implementing it plus its operands
+struct ThreadedOp {
+    const void* label;
+    Op op;
+};
+
+// One ThreadedOp per address. Slots start out pointing at the decode label of Emulator::run_threaded and
+// are filled in the first time that address is executed.
+class ThreadedCode
+{
+private:
+    std::vector<ThreadedOp> slots;
+    const void* decode{ nullptr };
+public:
+    ThreadedOp* prepare(const void* decode_label) {
+        if (slots.empty() || decode != decode_label) {
+            decode = decode_label;
+            slots.assign(0x10000, ThreadedOp{ decode_label, Op{} });
+        }
+        return slots.data();
+    }
+    // An instruction is two bytes, so both the slot at address and the one before it read this byte
+    void invalidate(uint16_t address) {
+        if (slots.empty())
+            return;
+        slots[address].label = decode;
+        slots[(uint16_t)(address - 1)].label = decode;
+    }
+    void clear() { slots.clear(); }
+};
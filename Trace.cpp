@@ -0,0 +1,73 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <iostream>
+
+Tracer::Tracer(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    ring.resize(size);
+    mask = size - 1;
+}
+
+bool Tracer::start(const char* path) {
+    stop();
+    file = fopen(path, "wb");
+    if (!file) {
+        std::cout << "Can't write trace " << path << std::endl;
+        return false;
+    }
+    uint32_t header[2] = { TRACE_VERSION, sizeof(TraceRecord) };
+    fwrite(TRACE_MAGIC, 1, 8, file);
+    fwrite(header, sizeof(header), 1, file);
+    // Anything pushed before the file was opened is stale
+    tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    tail_seen = tail.load(std::memory_order_relaxed);
+    sequence = 0;
+    dropped = 0;
+    stopping = false;
+    drain_thread = std::thread(&Tracer::drain, this);
+    return true;
+}
+
+// Writes out everything between tail and head, wrapping at most once. Returns the records written.
+size_t Tracer::write_available() {
+    uint64_t start = tail.load(std::memory_order_relaxed);
+    uint64_t end = head.load(std::memory_order_acquire);
+    size_t written = 0;
+    while (start != end) {
+        size_t index = start & mask;
+        size_t count = end - start;
+        if (count > ring.size() - index)
+            count = ring.size() - index;
+        if (count > TRACE_DRAIN_BATCH)
+            count = TRACE_DRAIN_BATCH;
+        fwrite(&ring[index], sizeof(TraceRecord), count, file);
+        start += count;
+        written += count;
+        // Hands the slots back as soon as they are written so the producer drops as little as possible
+        tail.store(start, std::memory_order_release);
+    }
+    return written;
+}
+
+void Tracer::drain() {
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (!write_available())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    write_available();
+}
+
+void Tracer::stop() {
+    if (!file)
+        return;
+    stopping.store(true, std::memory_order_release);
+    drain_thread.join();
+    fclose(file);
+    file = nullptr;
+    if (dropped)
+        std::cout << "Trace dropped " << dropped << " records" << std::endl;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Set to 0 to build the core without the tracer, Emulator then has no tracing code at all
+#ifndef CHIP8_TRACE
+#define CHIP8_TRACE 1
+#endif
+
+#define TRACE_MAGIC "CH8TRACE"
+#define TRACE_VERSION 1
+#define TRACE_DEFAULT_RECORDS (1u << 20)
+#define TRACE_DRAIN_BATCH 4096
+
+// One executed instruction. Trace files are a header followed by these, little endian.
+struct TraceRecord {
+    uint32_t sequence;      // Instructions traced before this one, a gap means records were dropped
+    uint16_t pc;            // Address the instruction was fetched from
+    uint16_t opcode;
+    uint16_t i_register;    // Everything below is after the instruction
+    uint16_t changed;       // Bit n set when Vn changed
+    uint8_t vx;             // V of the opcode's X nibble
+    uint8_t vf;
+    uint8_t padding[2];
+};
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord is written to files as is");
+
+// Bit n set for every non zero byte n of x
+inline uint8_t nonzero_bytes(uint64_t x) {
+    uint64_t high = (((x & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | x) & 0x8080808080808080ull;
+    return (uint8_t)(((high >> 7) * 0x0102040810204080ull) >> 56);
+}
+
+// Instruction trace: a fixed size single producer, single consumer ring the emulator thread pushes records
+// into without locking, and a thread that drains it to a file. When the writer falls behind, records are
+// dropped rather than stalling the emulator, the sequence numbers show where.
+class Tracer
+{
+private:
+    std::vector<TraceRecord> ring;
+    uint64_t mask;
+    // Producer side, only touched by the emulator thread apart from head
+    alignas(64) std::atomic<uint64_t> head{ 0 };
+    uint64_t tail_seen{ 0 };
+    uint32_t sequence{ 0 };
+    uint64_t dropped{ 0 };
+    // Consumer side
+    alignas(64) std::atomic<uint64_t> tail{ 0 };
+    std::atomic<bool> stopping{ false };
+    std::thread drain_thread;
+    FILE* file{ nullptr };
+
+    void drain();
+    size_t write_available();
+public:
+    // capacity is rounded up to a power of two
+    explicit Tracer(size_t capacity = TRACE_DEFAULT_RECORDS);
+    ~Tracer() { stop(); }
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // Starts the drain thread writing to path, before the tracer is handed to an emulator. False if the
+    // file can't be created.
+    bool start(const char* path);
+    // Writes out what is left and closes the file
+    void stop();
+    bool running() const { return file != nullptr; }
+    uint64_t dropped_count() const { return dropped; }
+
+    // Emulator thread only. registers_before is V0-VF before the instruction ran, registers after it.
+    void record(uint16_t pc, uint16_t opcode, uint16_t i_register, const uint8_t* registers_before, const uint8_t* registers) {
+        uint64_t position = head.load(std::memory_order_relaxed);
+        if (position - tail_seen == ring.size()) {
+            tail_seen = tail.load(std::memory_order_acquire);
+            if (position - tail_seen == ring.size()) {
+                dropped++;
+                sequence++;
+                return;
+            }
+        }
+        uint64_t before[2], after[2];
+        memcpy(before, registers_before, sizeof(before));
+        memcpy(after, registers, sizeof(after));
+        TraceRecord& entry = ring[position & mask];
+        entry.sequence = sequence++;
+        entry.pc = pc;
+        entry.opcode = opcode;
+        entry.i_register = i_register;
+        entry.changed = nonzero_bytes(before[0] ^ after[0]) | (nonzero_bytes(before[1] ^ after[1]) << 8);
+        entry.vx = registers[(opcode >> 8) & 0xF];
+        entry.vf = registers[0xF];
+        entry.padding[0] = entry.padding[1] = 0;
+        head.store(position + 1, std::memory_order_release);
+    }
+};
@@ -0,0 +1,65 @@
+#include "VecEnv.h"
+#include "Hash.h"
+
+#include <algorithm>
+
+VecEnv::VecEnv(const uint8_t* rom, uint32_t rom_size, uint32_t count, uint32_t cycles_per_frame,
+    uint32_t max_frames, unsigned threads, uint64_t seed)
+    : display(128 * 64), planes((size_t)count * VEC_ENV_PLANE_WORDS), done(count), frames(count),
+    episodes(count), max_frames(max_frames), seed(seed), pool(threads) {
+    initial = std::make_unique<Emulator>(display.data());
+    initial->load_rom(rom, rom_size);
+    for (uint32_t i = 0; i < count; i++) {
+        instances.push_back(std::make_unique<Emulator>(display.data()));
+        instances[i]->set_cycles_per_frame(cycles_per_frame);
+    }
+    reset();
+}
+
+void VecEnv::reset_instance(size_t i) {
+    instances[i]->copy_state(*initial);
+    // The state copied in carries the initial machine's generator. Hashed, since seeds a step apart would
+    // give SplitMix64 streams that are the same one shifted by a draw.
+    uint64_t key[3] = { seed, i, episodes[i]++ };
+    instances[i]->set_random_seed(fnv1a((const uint8_t*)key, sizeof(key)));
+    instances[i]->read_changed_planes(&planes[i * VEC_ENV_PLANE_WORDS]);
+    done[i] = 0;
+    frames[i] = 0;
+}
+
+void VecEnv::reset(const uint8_t* which) {
+    pool.run((instances.size() + VEC_ENV_CHUNK - 1) / VEC_ENV_CHUNK, [&](size_t chunk) {
+        size_t end = std::min(instances.size(), (chunk + 1) * VEC_ENV_CHUNK);
+        for (size_t i = chunk * VEC_ENV_CHUNK; i < end; i++) {
+            if (!which || which[i])
+                reset_instance(i);
+        }
+    });
+}
+
+void VecEnv::step(const uint16_t* keys) {
+    pool.run((instances.size() + VEC_ENV_CHUNK - 1) / VEC_ENV_CHUNK, [&](size_t chunk) {
+        size_t end = std::min(instances.size(), (chunk + 1) * VEC_ENV_CHUNK);
+        for (size_t i = chunk * VEC_ENV_CHUNK; i < end; i++) {
+            if (done[i])
+                continue;
+            Emulator& emulator = *instances[i];
+            emulator.set_keys(keys[i]);
+            emulator.run_frame();
+            frames[i]++;
+            emulator.read_changed_planes(&planes[i * VEC_ENV_PLANE_WORDS]);
+            done[i] = emulator.is_paused() || (max_frames && frames[i] >= max_frames);
+        }
+    });
+}
+
+void VecEnv::set_seed(uint64_t seed) {
+    this->seed = seed;
+    std::fill(episodes.begin(), episodes.end(), 0);
+}
+
+void VecEnv::set_engine(Engine engine) {
+    for (auto& instance : instances) {
+        instance->set_engine(engine);
+    }
+}
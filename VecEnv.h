@@ -0,0 +1,59 @@
+#pragma once
+#include "Emulator.h"
+#include "WorkStealingPool.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// uint64_t words of bitplanes per instance: 2 planes of 64 rows, see Emulator::read_planes
+#define VEC_ENV_PLANE_WORDS (2 * 64 * DISPLAY_ROW_WORDS)
+// Instances stepped by one pool task
+#define VEC_ENV_CHUNK 32
+
+// A batch of emulators running the same ROM for training agents. Per instance outputs are kept in
+// structure of arrays form, planes for every instance back to back, then done flags and frame counts,
+// so a caller can wrap each array without copying.
+//
+// Each machine is still a regular Emulator. Its state is mostly memory and stack, and instances branch
+// apart after a few frames, so there is nothing to gain from interleaving them field by field. Lockstep
+// does that for instances that stay at the same address. Nor can the planes be handed out as the
+// machine keeps them: vertical scrolls rotate the rows and low resolution uses half size planes. A step
+// copies the rows that changed instead, which for most frames is a sprite's worth or nothing.
+class VecEnv
+{
+private:
+    std::vector<Color> display;                     // Shared and never synced, only the bitplanes are read
+    std::unique_ptr<Emulator> initial;              // Machine right after loading, every reset copies it
+    std::vector<std::unique_ptr<Emulator>> instances;
+    std::vector<uint64_t> planes;
+    std::vector<uint8_t> done;
+    std::vector<uint32_t> frames;
+    std::vector<uint64_t> episodes;                 // Resets of each instance since the seed was set
+    uint32_t max_frames;
+    uint64_t seed;
+    WorkStealingPool pool;
+
+    void reset_instance(size_t i);
+public:
+    // max_frames ends an episode after that many frames, 0 only ends it when the ROM exits with 00FD.
+    // threads works as for WorkStealingPool. CXNN in each episode of each instance draws from its own
+    // generator, seeded from seed, the instance index and the episode number.
+    VecEnv(const uint8_t* rom, uint32_t rom_size, uint32_t count, uint32_t cycles_per_frame,
+        uint32_t max_frames = 0, unsigned threads = 0, uint64_t seed = DEFAULT_RANDOM_SEED);
+
+    size_t size() const { return instances.size(); }
+    // which[i] non zero resets instance i, nullptr resets all of them
+    void reset(const uint8_t* which = nullptr);
+    // Restarts the episode numbering with a new seed, from the next reset on. The same seed and sequence
+    // of resets and keys repeat the same episodes.
+    void set_seed(uint64_t seed);
+    // Runs one frame on every instance that is not done, with keys[i] as the key mask of instance i
+    void step(const uint16_t* keys);
+    void set_engine(Engine engine);
+
+    // Valid until the VecEnv is destroyed, the contents change with every step and reset
+    const uint64_t* get_planes() const { return planes.data(); }
+    const uint8_t* get_done() const { return done.data(); }
+    const uint32_t* get_frames() const { return frames.data(); }
+};
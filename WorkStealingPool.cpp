@@ -0,0 +1,100 @@
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    for (unsigned i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (unsigned i = 0; i + 1 < threads; i++) {
+        this->threads.emplace_back(&WorkStealingPool::worker, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+bool WorkStealingPool::pop(size_t queue, size_t& item) {
+    WorkQueue& own = *queues[queue];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (own.items.empty())
+        return false;
+    item = own.items.back();
+    own.items.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t thief, size_t& item) {
+    for (size_t i = 1; i < queues.size(); i++) {
+        WorkQueue& victim = *queues[(thief + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.items.empty()) {
+            item = victim.items.front();
+            victim.items.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::drain(size_t queue) {
+    // Queues only shrink during a batch, so once nothing is left to steal this thread is done
+    size_t item;
+    while (pop(queue, item) || steal(queue, item)) {
+        (*task)(item);
+    }
+}
+
+void WorkStealingPool::worker(size_t queue) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(state_lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        drain(queue);
+        {
+            std::lock_guard<std::mutex> guard(state_lock);
+            if (--busy == 0)
+                finished.notify_all();
+        }
+    }
+}
+
+void WorkStealingPool::run(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0)
+        return;
+    // Contiguous ranges, neighbouring tasks tend to touch neighbouring data
+    for (size_t i = 0; i < queues.size(); i++) {
+        WorkQueue& queue = *queues[i];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        for (size_t item = count * i / queues.size(); item < count * (i + 1) / queues.size(); item++) {
+            queue.items.push_back(item);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        this->task = &task;
+        busy = (unsigned)threads.size();
+        generation++;
+    }
+    wake.notify_all();
+    drain(queues.size() - 1);
+
+    std::unique_lock<std::mutex> guard(state_lock);
+    finished.wait(guard, [&] { return busy == 0; });
+    this->task = nullptr;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run batches of indexed tasks. Each batch is split evenly over per
+// thread queues, a thread works through its own queue from the back and steals from the front of the
+// others once it runs dry, so uneven tasks (a ROM that runs slower than the rest) still keep every
+// core busy.
+class WorkStealingPool
+{
+private:
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<size_t> items;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkQueue>> queues;     // One per thread, the last is the caller's
+    std::mutex state_lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* task{ nullptr };
+    uint64_t generation{ 0 };
+    unsigned busy{ 0 };
+    bool stopping{ false };
+
+    bool pop(size_t queue, size_t& item);
+    bool steal(size_t thief, size_t& item);
+    void drain(size_t queue);
+    void worker(size_t queue);
+public:
+    // threads counts the caller, which works on every batch too. 0 uses every hardware thread.
+    explicit WorkStealingPool(unsigned threads = 0);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return (unsigned)queues.size(); }
+    // Calls task(i) once for every i in [0, count) and returns when all of them have finished
+    void run(size_t count, const std::function<void(size_t)>& task);
+};
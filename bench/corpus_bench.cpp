@@ -0,0 +1,286 @@
+// ROM corpus benchmark: runs a fixed set of small ROMs, each stressing one part of the emulator, headless
+// for a fixed instruction count and reports emulated MIPS and ns per frame with their spread across
+// repetitions. A frame is cycles_per_frame instructions, the timer tick and sync_display, as the debugger
+// runs them. Output is JSON with one line per ROM in a fixed order, so reports from two builds diff cleanly.
+// The state hash of each ROM covers the screen, V0-VF, I, PC and the data past 0x300, where the ROMs that
+// don't draw leave their results. It must not change between builds or engines.
+//
+//   corpus_bench [--engine name] [--instructions N] [--cycles-per-frame N] [--repetitions N]
+//                [--output report.json]
+#include "Emulator.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define BENCH_DEFAULT_INSTRUCTIONS 20000000ull
+#define BENCH_DEFAULT_CYCLES_PER_FRAME 1000
+#define BENCH_DEFAULT_REPETITIONS 5
+#define CORPUS_DATA_START 0x300     // Everything below is font and code
+
+// High resolution 16x16 and 8x10 sprites at X stepping by 9, so most draws are unaligned, clearing the
+// screen every 256 iterations
+static const uint8_t draw_hires_rom[] = {
+    0x00, 0xFF,     // 200: high resolution
+    0x60, 0x00,     // 202: V0 = 0
+    0x61, 0x00,     // 204: V1 = 0
+    0xA2, 0x00,     // 206: I = 200, the code doubles as sprite data
+    0xD0, 0x10,     // 208: draw 16x16 at V0, V1
+    0xD0, 0x1A,     // 20A: draw 8x10 at V0, V1
+    0x70, 0x09,     // 20C: V0 += 9
+    0x71, 0x03,     // 20E: V1 += 3
+    0x30, 0x80,     // 210: skip if V0 == 80
+    0x12, 0x08,     // 212: jump 208
+    0x00, 0xE0,     // 214: clear
+    0x12, 0x08      // 216: jump 208
+};
+
+// Native low resolution 8x15 and 8x5 sprites
+static const uint8_t draw_lores_rom[] = {
+    0x60, 0x00,     // 200: V0 = 0
+    0x61, 0x00,     // 202: V1 = 0
+    0xA2, 0x00,     // 204: I = 200
+    0xD0, 0x1F,     // 206: draw 8x15 at V0, V1
+    0xD0, 0x15,     // 208: draw 8x5 at V0, V1
+    0x70, 0x03,     // 20A: V0 += 3
+    0x71, 0x02,     // 20C: V1 += 2
+    0x30, 0x81,     // 20E: skip if V0 == 81
+    0x12, 0x06,     // 210: jump 206
+    0x00, 0xE0,     // 212: clear
+    0x12, 0x06      // 214: jump 206
+};
+
+// Every scroll opcode once per sprite, in high resolution
+static const uint8_t scroll_hires_rom[] = {
+    0x00, 0xFF,     // 200: high resolution
+    0x60, 0x00,     // 202: V0 = 0
+    0x61, 0x00,     // 204: V1 = 0
+    0xA2, 0x00,     // 206: I = 200
+    0xD0, 0x10,     // 208: draw 16x16 at V0, V1
+    0x00, 0xC3,     // 20A: scroll down 3
+    0x00, 0xFB,     // 20C: scroll right 4
+    0x00, 0xD2,     // 20E: scroll up 2
+    0x00, 0xFC,     // 210: scroll left 4
+    0x70, 0x07,     // 212: V0 += 7
+    0x71, 0x05,     // 214: V1 += 5
+    0x12, 0x08      // 216: jump 208
+};
+
+// The same in low resolution, where scrolls work on the native 64x32 planes
+static const uint8_t scroll_lores_rom[] = {
+    0x60, 0x00,     // 200: V0 = 0
+    0x61, 0x00,     // 202: V1 = 0
+    0xA2, 0x00,     // 204: I = 200
+    0xD0, 0x18,     // 206: draw 8x8 at V0, V1
+    0x00, 0xC3,     // 208: scroll down 3
+    0x00, 0xFB,     // 20A: scroll right 4
+    0x00, 0xD2,     // 20C: scroll up 2
+    0x00, 0xFC,     // 20E: scroll left 4
+    0x70, 0x07,     // 210: V0 += 7
+    0x71, 0x05,     // 212: V1 += 5
+    0x12, 0x06      // 214: jump 206
+};
+
+// Register arithmetic, both skip directions and a call, no display or memory writes
+static const uint8_t arith_rom[] = {
+    0x60, 0x00,     // 200: V0 = 0
+    0x61, 0x00,     // 202: V1 = 0
+    0x62, 0x05,     // 204: V2 = 5
+    0x70, 0x01,     // 206: V0 += 1
+    0x81, 0x04,     // 208: V1 += V0
+    0x82, 0x03,     // 20A: V2 ^= V0
+    0x83, 0x16,     // 20C: V3 = V1 >> 1
+    0x84, 0x0E,     // 20E: V4 = V0 << 1
+    0x85, 0x25,     // 210: V5 -= V2
+    0x86, 0x37,     // 212: V6 = V3 - V6
+    0x87, 0x41,     // 214: V7 |= V4
+    0x88, 0x52,     // 216: V8 &= V5
+    0x52, 0x30,     // 218: skip if V2 == V3
+    0x22, 0x30,     // 21A: call 230
+    0x49, 0x17,     // 21C: skip if V9 != 17
+    0x69, 0x00,     // 21E: V9 = 0
+    0x79, 0x01,     // 220: V9 += 1
+    0x12, 0x06,     // 222: jump 206
+    0x00, 0x00,     // 224
+    0x00, 0x00,     // 226
+    0x00, 0x00,     // 228
+    0x00, 0x00,     // 22A
+    0x00, 0x00,     // 22C
+    0x00, 0x00,     // 22E
+    0x8A, 0x14,     // 230: VA += V1
+    0x8B, 0xA5,     // 232: VB -= VA
+    0x00, 0xEE      // 234: return
+};
+
+// BCD, register loads and stores and I arithmetic, writing to data past the code
+static const uint8_t memory_rom[] = {
+    0x65, 0x00,     // 200: V5 = 0
+    0xA3, 0x00,     // 202: I = 300
+    0x75, 0x01,     // 204: V5 += 1
+    0xF5, 0x33,     // 206: BCD V5 at I
+    0xF2, 0x65,     // 208: load V0-V2, I += 3
+    0xF7, 0x55,     // 20A: store V0-V7, I += 8
+    0xF0, 0x1E,     // 20C: I += V0
+    0x35, 0x00,     // 20E: skip if V5 == 0
+    0x12, 0x04,     // 210: jump 204
+    0x12, 0x02      // 212: jump 202
+};
+
+struct CorpusRom {
+    const char* name;
+    const uint8_t* data;
+    uint32_t size;
+};
+
+#define CORPUS_ROM(name) { #name, name##_rom, sizeof(name##_rom) }
+static const CorpusRom corpus[] = {
+    CORPUS_ROM(draw_hires),
+    CORPUS_ROM(draw_lores),
+    CORPUS_ROM(scroll_hires),
+    CORPUS_ROM(scroll_lores),
+    CORPUS_ROM(arith),
+    CORPUS_ROM(memory),
+};
+
+static const char* engine_names[] = { "interpreter", "blocks", "jit", "aot", "threaded" };
+
+static bool parse_engine(const char* name, Engine& engine) {
+    for (size_t i = 0; i < sizeof(engine_names) / sizeof(engine_names[0]); i++) {
+        if (strcmp(name, engine_names[i]) == 0) {
+            engine = (Engine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Spread {
+    double mean;
+    double stddev;      // Sample standard deviation
+    double min;
+    double max;
+};
+
+static Spread spread(const std::vector<double>& values) {
+    Spread result{ 0, 0, values[0], values[0] };
+    for (double value : values) {
+        result.mean += value;
+        result.min = std::min(result.min, value);
+        result.max = std::max(result.max, value);
+    }
+    result.mean /= values.size();
+    if (values.size() > 1) {
+        for (double value : values) {
+            result.stddev += (value - result.mean) * (value - result.mean);
+        }
+        result.stddev = std::sqrt(result.stddev / (values.size() - 1));
+    }
+    return result;
+}
+
+static Color display[128 * 64];
+static MachineState final_state;
+
+// One repetition from a fresh load, returns the seconds taken and the state hash at the end
+static double run_once(const CorpusRom& rom, Engine engine, uint64_t instructions, uint32_t cycles_per_frame, uint64_t& hash) {
+    Emulator emulator{ display };
+    emulator.load_rom(rom.data, rom.size);
+    emulator.set_engine(engine);
+    emulator.set_cycles_per_frame(cycles_per_frame);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t done = 0; done < instructions; done += cycles_per_frame) {
+        emulator.run_frame();
+        emulator.sync_display();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    emulator.save_state(final_state);
+    hash = fnv1a((const uint8_t*)display, sizeof(display));
+    hash = fnv1a(final_state.register_file, sizeof(final_state.register_file), hash);
+    hash = fnv1a((const uint8_t*)&final_state.i_register, sizeof(final_state.i_register), hash);
+    hash = fnv1a((const uint8_t*)&final_state.program_counter, sizeof(final_state.program_counter), hash);
+    hash = fnv1a(final_state.memory + CORPUS_DATA_START, MEM_SIZE - CORPUS_DATA_START, hash);
+    return seconds;
+}
+
+static void usage() {
+    printf("usage: corpus_bench [--engine name] [--instructions N] [--cycles-per-frame N] [--repetitions N]\n"
+           "                    [--output report.json]\n");
+}
+
+int main(int argc, char** argv) {
+    Engine engine = Engine::Interpreter;
+    uint64_t instructions = BENCH_DEFAULT_INSTRUCTIONS;
+    uint32_t cycles_per_frame = BENCH_DEFAULT_CYCLES_PER_FRAME;
+    uint32_t repetitions = BENCH_DEFAULT_REPETITIONS;
+    const char* output_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--instructions") == 0 && has_value)
+            instructions = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--cycles-per-frame") == 0 && has_value)
+            cycles_per_frame = (uint32_t)std::min<uint64_t>(strtoull(argv[++i], nullptr, 10), MAX_CYCLES_PER_FRAME);
+        else if (strcmp(argv[i], "--repetitions") == 0 && has_value)
+            repetitions = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--output") == 0 && has_value)
+            output_path = argv[++i];
+        else if (strcmp(argv[i], "--engine") == 0 && has_value) {
+            if (!parse_engine(argv[++i], engine)) {
+                printf("Unknown engine %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (engine == Engine::Aot) {
+        printf("The corpus has no AOT modules, use another engine\n");
+        return 1;
+    }
+    cycles_per_frame = std::max<uint32_t>(cycles_per_frame, 1);
+    repetitions = std::max<uint32_t>(repetitions, 1);
+    // Whole frames only
+    uint64_t frames = std::max<uint64_t>((instructions + cycles_per_frame - 1) / cycles_per_frame, 1);
+    instructions = frames * cycles_per_frame;
+
+    FILE* output = output_path ? fopen(output_path, "w") : stdout;
+    if (!output) {
+        printf("Can't write %s\n", output_path);
+        return 1;
+    }
+    // The emulator logs ROM loads
+    std::cout.setstate(std::ios::failbit);
+
+    fprintf(output, "{\n  \"engine\": \"%s\",\n  \"instructions\": %llu,\n  \"cycles_per_frame\": %u,\n  \"repetitions\": %u,\n  \"roms\": [",
+        engine_names[(size_t)engine], (unsigned long long)instructions, cycles_per_frame, repetitions);
+    for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) {
+        const CorpusRom& rom = corpus[i];
+        uint64_t hash;
+        // Warm up, the first run pays for page faults and code cache misses
+        run_once(rom, engine, instructions, cycles_per_frame, hash);
+        std::vector<double> mips, frame_ns;
+        for (uint32_t repetition = 0; repetition < repetitions; repetition++) {
+            double seconds = run_once(rom, engine, instructions, cycles_per_frame, hash);
+            mips.push_back(instructions / seconds / 1e6);
+            frame_ns.push_back(seconds * 1e9 / frames);
+        }
+        Spread mips_spread = spread(mips);
+        Spread frame_spread = spread(frame_ns);
+        fprintf(output, "%s\n    { \"rom\": \"%s\", \"mips\": %.2f, \"mips_stddev\": %.2f, \"mips_min\": %.2f, \"mips_max\": %.2f, "
+            "\"ns_per_frame\": %.0f, \"ns_per_frame_stddev\": %.0f, \"state_hash\": \"%016llx\" }",
+            i ? "," : "", rom.name, mips_spread.mean, mips_spread.stddev, mips_spread.min, mips_spread.max,
+            frame_spread.mean, frame_spread.stddev, (unsigned long long)hash);
+        fflush(output);
+    }
+    fprintf(output, "\n  ]\n}\n");
+    if (output != stdout)
+        fclose(output);
+    return 0;
+}
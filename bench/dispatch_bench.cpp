@@ -0,0 +1,131 @@
+// Dispatch microbenchmark: runs the same register heavy ROM on the switchless interpreter and the
+// threaded engine and reports instructions per second. On Linux it also counts host branch misses
+// through perf_event_open, elsewhere (or without permission) those columns read n/a.
+//
+//   dispatch_bench [instructions]
+#include "Emulator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_DEFAULT_INSTRUCTIONS 200000000u
+#define BENCH_BATCH 100000u
+
+// Mixes ALU ops, both skip directions, a call and a backwards jump so the opcode sequence is not a
+// single repeating pair
+static const uint8_t bench_rom[] = {
+    0x60, 0x00,     // 200: V0 = 0
+    0x61, 0x00,     // 202: V1 = 0
+    0x70, 0x01,     // 204: V0 += 1
+    0x81, 0x04,     // 206: V1 += V0
+    0x82, 0x06,     // 208: V2 = V0 >> 1
+    0x32, 0x03,     // 20A: skip if V2 == 3
+    0x22, 0x20,     // 20C: call 220
+    0x83, 0x13,     // 20E: V3 ^= V1
+    0x40, 0x17,     // 210: skip if V0 != 0x17
+    0x60, 0x00,     // 212: V0 = 0
+    0xA3, 0x00,     // 214: I = 300
+    0xF0, 0x1E,     // 216: I += V0
+    0x81, 0x25,     // 218: V1 -= V2
+    0x12, 0x04,     // 21A: jump 204
+    0x00, 0x00,     // 21C
+    0x00, 0x00,     // 21E
+    0x84, 0x26,     // 220: V4 = V2 >> 1
+    0x85, 0x4E,     // 222: V5 = V4 << 1
+    0x86, 0x57,     // 224: V6 = V5 - V6
+    0x00, 0xEE      // 226: return
+};
+
+class BranchMissCounter
+{
+private:
+    int fd{ -1 };
+public:
+    BranchMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+    ~BranchMissCounter() {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+    bool available() const { return fd >= 0; }
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    uint64_t stop() {
+        uint64_t misses = 0;
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+                misses = 0;
+        }
+#endif
+        return misses;
+    }
+};
+
+static Color display[128 * 64];
+
+static void bench(const char* name, Engine engine, uint64_t instructions) {
+    Emulator emu{ display };
+    emu.load_rom(bench_rom, sizeof(bench_rom));
+    emu.set_engine(engine);
+    // Warm up, fills the per address caches
+    emu.run_cycles(BENCH_BATCH);
+
+    BranchMissCounter counter;
+    counter.start();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t done = 0; done < instructions; done += BENCH_BATCH) {
+        emu.run_cycles(BENCH_BATCH);
+    }
+    auto end = std::chrono::steady_clock::now();
+    uint64_t misses = counter.stop();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    printf("%-12s %10.1f MIPS", name, instructions / seconds / 1e6);
+    if (counter.available())
+        printf(" %14llu branch misses %8.4f per instruction\n", (unsigned long long)misses, (double)misses / instructions);
+    else
+        printf(" %14s branch misses %8s per instruction\n", "n/a", "n/a");
+}
+
+int main(int argc, char** argv) {
+    uint64_t instructions = argc > 1 ? strtoull(argv[1], nullptr, 10) : BENCH_DEFAULT_INSTRUCTIONS;
+    // The emulator logs ROM loads, keep the table readable
+    std::cout.setstate(std::ios::failbit);
+
+    bench("Interpreter", Engine::Interpreter, instructions);
+#if THREADED_SUPPORTED
+    bench("Threaded", Engine::Threaded, instructions);
+#else
+    printf("%-12s not built, needs computed goto (GCC or Clang)\n", "Threaded");
+#endif
+    return 0;
+}
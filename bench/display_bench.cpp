@@ -0,0 +1,122 @@
+// Display kernel microbenchmark: checks that every bitplane to RGBA and scroll kernel this CPU supports
+// produces output identical to the scalar reference, then times full 128x64 frames with each of them.
+// --check stops after the comparisons, ctest runs it that way. Returns non zero on any difference.
+//
+//   display_bench [frames | --check]
+#include "DisplayKernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define BENCH_DEFAULT_FRAMES 200000u
+#define FRAME_WORDS (2 * 64)
+#define FRAME_PIXELS (128 * 64)
+
+static const Color palette[4] = {
+    { 0x00, 0x00, 0x00, 0xFF },
+    { 0xFF, 0xFF, 0xFF, 0xFE },
+    { 0x55, 0x55, 0x55, 0xFD },
+    { 0xAA, 0xAA, 0xAA, 0xFC }
+};
+
+int main(int argc, char** argv) {
+    bool check_only = argc > 1 && strcmp(argv[1], "--check") == 0;
+    uint32_t frames = argc > 1 && !check_only ? (uint32_t)strtoul(argv[1], nullptr, 10) : BENCH_DEFAULT_FRAMES;
+
+    std::mt19937 random(1234);
+    std::vector<uint64_t> plane0(FRAME_WORDS);
+    std::vector<uint64_t> plane1(FRAME_WORDS);
+    for (size_t i = 0; i < FRAME_WORDS; i++) {
+        plane0[i] = ((uint64_t)random() << 32) | random();
+        plane1[i] = ((uint64_t)random() << 32) | random();
+    }
+
+    ExpandPlanesKernel kernels[4];
+    size_t count = available_expand_planes(kernels, 4);
+    std::vector<Color> reference(FRAME_PIXELS);
+    std::vector<Color> output(FRAME_PIXELS);
+    expand_planes_scalar(plane0.data(), plane1.data(), palette, reference.data(), FRAME_WORDS);
+
+    bool identical = true;
+    for (size_t k = 0; k < count; k++) {
+        // Odd lengths and offsets as well as the whole frame, sync_display converts runs of dirty rows
+        for (size_t start : { (size_t)0, (size_t)1, (size_t)17 }) {
+            for (size_t length : { (size_t)1, (size_t)2, (size_t)15, (size_t)FRAME_WORDS - start }) {
+                std::fill(output.begin(), output.end(), Color{ 0, 0, 0, 0 });
+                kernels[k].function(plane0.data() + start, plane1.data() + start, palette, output.data() + start * 64, length);
+                if (memcmp(output.data() + start * 64, reference.data() + start * 64, length * 64 * sizeof(Color)) != 0) {
+                    printf("%-8s differs from scalar at offset %zu length %zu\n", kernels[k].name, start, length);
+                    identical = false;
+                }
+            }
+        }
+    }
+
+    if (!check_only)
+        printf("%-8s %12s %12s %10s\n", "kernel", "ns/frame", "Mpixel/s", "speedup");
+    double scalar_ns = 0;
+    for (size_t k = 0; k < count && !check_only; k++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            kernels[k].function(plane0.data(), plane1.data(), palette, output.data(), FRAME_WORDS);
+            // Keep the stores from being hoisted out of the loop
+            plane0[frame % FRAME_WORDS] ^= output[frame % FRAME_PIXELS].r;
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / frames;
+        if (k == 0)
+            scalar_ns = ns;
+        printf("%-8s %12.1f %12.1f %9.2fx\n", kernels[k].name, ns, FRAME_PIXELS / ns * 1e3, scalar_ns / ns);
+    }
+    printf("selected: %s, output %s\n", select_expand_planes().name, identical ? "bit-identical" : "MISMATCH");
+
+    // Scrolls run on both planes at once, 128 rows of two words
+    ScrollKernel scrolls[4];
+    size_t scroll_count = available_scroll(scrolls, 4);
+    bool scroll_identical = true;
+    std::vector<uint64_t> planes(plane0);
+    planes.insert(planes.end(), plane1.begin(), plane1.end());
+    std::vector<uint64_t> expected(planes.size());
+    std::vector<uint64_t> scrolled(planes.size());
+    for (size_t k = 0; k < scroll_count; k++) {
+        for (int direction = 0; direction < 2; direction++) {
+            // Odd row counts reach the single row tail of the wider kernels
+            for (size_t rows : { (size_t)1, (size_t)3, (size_t)64, (size_t)127, (size_t)128 }) {
+                expected = planes;
+                scrolled = planes;
+                (direction ? scroll_rows_right_scalar : scroll_rows_left_scalar)(expected.data(), rows);
+                (direction ? scrolls[k].right : scrolls[k].left)(scrolled.data(), rows);
+                if (expected != scrolled) {
+                    printf("%-8s %s scroll differs from scalar over %zu rows\n", scrolls[k].name, direction ? "right" : "left", rows);
+                    scroll_identical = false;
+                }
+            }
+        }
+    }
+
+    if (!check_only)
+        printf("\n%-8s %12s %10s\n", "scroll", "ns/frame", "speedup");
+    for (size_t k = 0; k < scroll_count && !check_only; k++) {
+        scrolled = planes;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            (frame & 1 ? scrolls[k].right : scrolls[k].left)(scrolled.data(), 2 * 64);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / frames;
+        if (k == 0)
+            scalar_ns = ns;
+        // Read the rows back so the work is not dropped
+        uint64_t checksum = 0;
+        for (uint64_t word : scrolled)
+            checksum ^= word;
+        printf("%-8s %12.1f %9.2fx  (%016llx)\n", scrolls[k].name, ns, scalar_ns / ns, (unsigned long long)checksum);
+    }
+    printf("selected: %s, output %s\n", select_scroll().name, scroll_identical ? "bit-identical" : "MISMATCH");
+    return identical && scroll_identical ? 0 : 1;
+}
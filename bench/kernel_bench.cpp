@@ -0,0 +1,152 @@
+// Kernel microbenchmark: times the display kernels one opcode at a time on synthetic input. Sprite draws of
+// 8xN and 16x16 sprites at byte aligned and unaligned X in high resolution, native low resolution and the
+// doubled low resolution a half pixel scroll leaves behind, every scroll opcode, clear and a full
+// sync_display. Every case starts from the same random screen, the checksum of the screen after the first
+// BENCH_CHECK_CALLS calls must not change when a kernel is rewritten.
+//
+// Bytes touched is what the current implementation reads or writes per call: sprite bytes, bitplane words
+// and for sync_display the RGBA output. A kernel that touches less should show it here.
+//
+//   kernel_bench [iterations]
+#include "Emulator.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#define BENCH_DEFAULT_ITERATIONS 1000000u
+#define BENCH_SPRITE_ADDRESS 0x300
+#define BENCH_Y 5
+#define BENCH_BACKGROUND_SPRITES 12
+#define BENCH_CHECK_CALLS 7
+#define SYNC_OPCODE 0x0000          // Not an opcode, times invalidate_display and sync_display
+
+enum class Mode {
+    Hires,
+    Lores,      // Native 64x32 planes
+    Doubled     // Low resolution drawn as 2x2 pixels on the high resolution planes
+};
+
+struct KernelCase {
+    const char* name;
+    Mode mode;
+    uint8_t x;              // V0, the draws use V0, V1
+    uint16_t opcode;
+    uint32_t divisor;       // Runs iterations / divisor times, for the slow ones
+    uint32_t bytes;
+};
+
+// A 128 pixel row is two words, every draw reads and writes both. Native low resolution rows are one word.
+#define HIRES_DRAW_BYTES(rows, sprite_bytes) ((sprite_bytes) + (rows) * 16)
+#define LORES_DRAW_BYTES(rows) ((rows) + (rows) * 8)
+// Doubled draws read the 2x wide sprite from the sprite cache, one word per doubled row
+#define DOUBLED_DRAW_BYTES(rows) (2 * (rows) * 8 + 2 * (rows) * 16)
+#define SYNC_BYTES(plane_bytes) (2 * (plane_bytes) + 128 * 64 * 4)
+
+static const KernelCase cases[] = {
+    { "draw 8x15 hires x=8", Mode::Hires, 8, 0xD01F, 1, HIRES_DRAW_BYTES(15, 15) },
+    { "draw 8x15 hires x=61", Mode::Hires, 61, 0xD01F, 1, HIRES_DRAW_BYTES(15, 15) },
+    { "draw 16x16 hires x=16", Mode::Hires, 16, 0xD010, 1, HIRES_DRAW_BYTES(16, 32) },
+    { "draw 16x16 hires x=57", Mode::Hires, 57, 0xD010, 1, HIRES_DRAW_BYTES(16, 32) },
+    { "draw 8x15 lores x=8", Mode::Lores, 8, 0xD01F, 1, LORES_DRAW_BYTES(15) },
+    { "draw 8x15 lores x=3", Mode::Lores, 3, 0xD01F, 1, LORES_DRAW_BYTES(15) },
+    { "draw 8x15 doubled x=8", Mode::Doubled, 8, 0xD01F, 1, DOUBLED_DRAW_BYTES(15) },
+    { "draw 8x15 doubled x=3", Mode::Doubled, 3, 0xD01F, 1, DOUBLED_DRAW_BYTES(15) },
+    { "draw 16x16 doubled x=3", Mode::Doubled, 3, 0xD010, 1, DOUBLED_DRAW_BYTES(16) },
+    // One plane is selected, the scrolls only touch that one
+    { "scroll down 4 hires", Mode::Hires, 0, 0x00C4, 1, 4 * 16 },
+    { "scroll up 4 hires", Mode::Hires, 0, 0x00D4, 1, 4 * 16 },
+    { "scroll right hires", Mode::Hires, 0, 0x00FB, 1, 64 * 16 },
+    { "scroll left hires", Mode::Hires, 0, 0x00FC, 1, 64 * 16 },
+    { "scroll down 4 lores", Mode::Lores, 0, 0x00C4, 1, 2 * 8 },
+    { "scroll up 4 lores", Mode::Lores, 0, 0x00D4, 1, 2 * 8 },
+    { "scroll right lores", Mode::Lores, 0, 0x00FB, 1, 32 * 8 },
+    { "scroll left lores", Mode::Lores, 0, 0x00FC, 1, 32 * 8 },
+    // Clears both representations of both planes
+    { "clear hires", Mode::Hires, 0, 0x00E0, 1, 2 * (64 * 16 + 32 * 8) },
+    { "clear lores", Mode::Lores, 0, 0x00E0, 1, 2 * (64 * 16 + 32 * 8) },
+    { "sync_display hires", Mode::Hires, 0, SYNC_OPCODE, 32, SYNC_BYTES(64 * 16) },
+    { "sync_display lores", Mode::Lores, 0, SYNC_OPCODE, 32, SYNC_BYTES(32 * 8) },
+};
+
+static Color display[128 * 64];
+
+// Loads a program that sets the mode, draws a random background and sets V0, V1 and I, runs it and leaves
+// the machine ready for the kernel
+static void setup(Emulator& emulator, const KernelCase& kernel) {
+    // Random sprites and positions, the same for every case
+    std::mt19937 random(1234);
+    std::vector<uint8_t> rom;
+    auto emit = [&rom](uint16_t opcode) {
+        rom.push_back((uint8_t)(opcode >> 8));
+        rom.push_back((uint8_t)opcode);
+    };
+    if (kernel.mode == Mode::Hires)
+        emit(0x00FF);
+    for (int i = 0; i < BENCH_BACKGROUND_SPRITES; i++) {
+        emit(0x6200 | (uint8_t)random());
+        emit(0x6300 | (uint8_t)random());
+        emit(0xA000 | (BENCH_SPRITE_ADDRESS + random() % 32));
+        emit(0xD23F);
+    }
+    // Half a low resolution pixel can only be shown on the high resolution planes
+    if (kernel.mode == Mode::Doubled)
+        emit(0x00C1);
+    emit(0x6000 | kernel.x);
+    emit(0x6100 | BENCH_Y);
+    emit(0xA000 | BENCH_SPRITE_ADDRESS);
+    size_t setup_length = rom.size() / 2;
+
+    rom.resize(BENCH_SPRITE_ADDRESS - 0x200);
+    for (int i = 0; i < 64; i++) {
+        rom.push_back((uint8_t)random());
+    }
+    emulator.load_rom(rom.data(), (uint32_t)rom.size());
+    for (size_t i = 0; i < setup_length; i++) {
+        emulator.step();
+    }
+    emulator.sync_display();
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : BENCH_DEFAULT_ITERATIONS;
+    // The emulator logs ROM loads
+    std::cout.setstate(std::ios::failbit);
+
+    printf("%-24s %10s %8s %10s %18s\n", "kernel", "ns/op", "bytes", "GB/s", "checksum");
+    std::vector<uint64_t> planes(2 * 64 * DISPLAY_ROW_WORDS);
+    for (const KernelCase& kernel : cases) {
+        Emulator emulator{ display };
+        setup(emulator, kernel);
+        uint32_t count = std::max(iterations / kernel.divisor, 1u);
+        const Op& op = Emulator::decode_table[kernel.opcode];
+        auto run = [&](uint32_t calls) {
+            for (uint32_t i = 0; i < calls; i++) {
+                if (kernel.opcode == SYNC_OPCODE) {
+                    emulator.invalidate_display();
+                    emulator.sync_display();
+                }
+                else
+                    op.handler(emulator, op);
+            }
+        };
+
+        // Whatever the first calls left on the planes and, once synced, in the RGBA output
+        run(BENCH_CHECK_CALLS);
+        emulator.read_planes(planes.data());
+        emulator.sync_display();
+        uint64_t checksum = fnv1a((const uint8_t*)planes.data(), planes.size() * sizeof(uint64_t)) ^
+            fnv1a((const uint8_t*)display, sizeof(display));
+
+        auto start = std::chrono::steady_clock::now();
+        run(count);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+        printf("%-24s %10.2f %8u %10.2f   %016llx\n", kernel.name, ns, kernel.bytes, kernel.bytes / ns, (unsigned long long)checksum);
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+// Lockstep throughput benchmark: runs the same number of instances of one ROM as separate Emulators and
+// as Lockstep groups of 8, 16 and 32 lanes, with per instance key input, and reports instructions per
+// second for each. Also checks that every lockstep lane ends in the same state as its scalar twin.
+//
+//   lockstep_bench [frames] [rom.ch8]
+//
+// The built in ROM reads a key every loop, so lanes split up and join again.
+#include "Lockstep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#define BENCH_DEFAULT_FRAMES 2000u
+#define BENCH_INSTANCES 256
+#define BENCH_CYCLES_PER_FRAME 1000
+
+static const uint8_t bench_rom[] = {
+    0x60, 0x00,     // 200: V0 = 0
+    0x61, 0x00,     // 202: V1 = 0
+    0x62, 0x05,     // 204: V2 = 5
+    0xE2, 0x9E,     // 206: skip if key V2 is down
+    0x71, 0x01,     // 208: V1 += 1
+    0x70, 0x01,     // 20A: V0 += 1
+    0x80, 0x14,     // 20C: V0 += V1
+    0x82, 0x06,     // 20E: V2 = V0 >> 1
+    0x83, 0x03,     // 210: V3 ^= V0
+    0x33, 0x17,     // 212: skip if V3 == 0x17
+    0x22, 0x20,     // 214: call 220
+    0xA3, 0x00,     // 216: I = 300
+    0xF0, 0x1E,     // 218: I += V0
+    0x12, 0x04,     // 21A: jump 204
+    0x00, 0x00,     // 21C
+    0x00, 0x00,     // 21E
+    0x84, 0x26,     // 220: V4 = V2 >> 1
+    0x85, 0x4E,     // 222: V5 = V4 << 1
+    0x86, 0x57,     // 224: V6 = V5 - V6
+    0x00, 0xEE      // 226: return
+};
+
+static Color display[128 * 64];
+
+// What has to match between a lane and its scalar twin: screen, registers, I, PC and instruction count
+struct Fingerprint {
+    uint64_t planes[2 * 64 * DISPLAY_ROW_WORDS];
+    uint8_t registers[16];
+    uint16_t i_register;
+    uint16_t program_counter;
+    uint64_t instructions;
+
+    explicit Fingerprint(const Emulator& emulator) {
+        emulator.read_planes(planes);
+        for (uint8_t i = 0; i < 16; i++) {
+            registers[i] = emulator.get_register(i);
+        }
+        i_register = emulator.get_i_register();
+        program_counter = emulator.get_program_counter();
+        instructions = emulator.get_instruction_count();
+    }
+    bool operator==(const Fingerprint& other) const {
+        return std::equal(std::begin(planes), std::end(planes), std::begin(other.planes)) &&
+            std::equal(std::begin(registers), std::end(registers), std::begin(other.registers)) &&
+            i_register == other.i_register && program_counter == other.program_counter && instructions == other.instructions;
+    }
+};
+
+// Key mask of every instance for every frame, the same for each run
+static std::vector<uint16_t> make_keys(uint32_t frames) {
+    std::mt19937 random(1234);
+    std::vector<uint16_t> keys((size_t)frames * BENCH_INSTANCES);
+    for (uint16_t& mask : keys) {
+        // Mostly idle, like a player
+        mask = (random() % 4 == 0) ? (uint16_t)(1u << (random() % 16)) : 0;
+    }
+    return keys;
+}
+
+static double bench_scalar(const std::vector<uint8_t>& rom, const std::vector<uint16_t>& keys, uint32_t frames, std::vector<Fingerprint>& results) {
+    std::vector<std::unique_ptr<Emulator>> instances;
+    for (int i = 0; i < BENCH_INSTANCES; i++) {
+        instances.push_back(std::make_unique<Emulator>(display));
+        instances[i]->load_rom(rom.data(), (uint32_t)rom.size());
+        instances[i]->set_engine(Engine::Interpreter);
+        instances[i]->set_cycles_per_frame(BENCH_CYCLES_PER_FRAME);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < BENCH_INSTANCES; i++) {
+            instances[i]->set_keys(keys[(size_t)frame * BENCH_INSTANCES + i]);
+            instances[i]->run_frame();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& instance : instances) {
+        results.emplace_back(*instance);
+    }
+    return seconds;
+}
+
+template <int LANES>
+static double bench_lockstep(const std::vector<uint8_t>& rom, const std::vector<uint16_t>& keys, uint32_t frames, std::vector<Fingerprint>& results) {
+    std::vector<std::unique_ptr<Lockstep<LANES>>> groups;
+    for (int g = 0; g < BENCH_INSTANCES / LANES; g++) {
+        groups.push_back(std::make_unique<Lockstep<LANES>>(rom.data(), (uint32_t)rom.size()));
+        groups[g]->set_cycles_per_frame(BENCH_CYCLES_PER_FRAME);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        for (int g = 0; g < BENCH_INSTANCES / LANES; g++) {
+            for (int l = 0; l < LANES; l++) {
+                groups[g]->lane(l).set_keys(keys[(size_t)frame * BENCH_INSTANCES + g * LANES + l]);
+            }
+            groups[g]->run_frame();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (int i = 0; i < BENCH_INSTANCES; i++) {
+        results.emplace_back(groups[i / LANES]->lane(i % LANES));
+    }
+    return seconds;
+}
+
+static void report(const char* name, double seconds, double scalar_seconds, uint32_t frames, const std::vector<Fingerprint>& results, const std::vector<Fingerprint>& reference, bool& identical) {
+    uint64_t instructions = 0;
+    int mismatches = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        instructions += results[i].instructions;
+        if (!(results[i] == reference[i]))
+            mismatches++;
+    }
+    if (mismatches)
+        identical = false;
+    printf("%-12s %10.1f MIPS %12.0f instance frames/s %8.2fx  %s\n", name, instructions / seconds / 1e6,
+        (double)frames * BENCH_INSTANCES / seconds, scalar_seconds / seconds, mismatches ? "MISMATCH" : "identical");
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : BENCH_DEFAULT_FRAMES;
+    std::vector<uint8_t> rom(std::begin(bench_rom), std::end(bench_rom));
+    if (argc > 2) {
+        std::ifstream file(argv[2], std::ios::binary);
+        if (!file) {
+            printf("Can't read %s\n", argv[2]);
+            return 1;
+        }
+        rom.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    // The emulator logs unimplemented opcodes, keep the table readable
+    std::cout.setstate(std::ios::failbit);
+
+    std::vector<uint16_t> keys = make_keys(frames);
+    std::vector<Fingerprint> reference;
+    std::vector<Fingerprint> results;
+    bool identical = true;
+    printf("%d instances, %u frames of %d instructions\n", BENCH_INSTANCES, frames, BENCH_CYCLES_PER_FRAME);
+
+    double scalar_seconds = bench_scalar(rom, keys, frames, reference);
+    report("scalar", scalar_seconds, scalar_seconds, frames, reference, reference, identical);
+    double seconds = bench_lockstep<8>(rom, keys, frames, results);
+    report("lockstep x8", seconds, scalar_seconds, frames, results, reference, identical);
+    results.clear();
+    seconds = bench_lockstep<16>(rom, keys, frames, results);
+    report("lockstep x16", seconds, scalar_seconds, frames, results, reference, identical);
+    results.clear();
+    seconds = bench_lockstep<32>(rom, keys, frames, results);
+    report("lockstep x32", seconds, scalar_seconds, frames, results, reference, identical);
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// Save state benchmark: times save_state and load_state on a running machine and checks that a loaded
+// state continues exactly like the machine it was saved from. Then records rewind history and steps back
+// through it, checking every frame.
+//
+//   state_bench [snapshots] [rom.ch8]
+#include "Rewind.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#define BENCH_DEFAULT_SNAPSHOTS 100000u
+#define BENCH_RING 64
+#define BENCH_CYCLES_PER_FRAME 1000
+#define BENCH_WARMUP_FRAMES 120
+#define BENCH_CHECK_FRAMES 600
+#define BENCH_REWIND_FRAMES 1800
+
+// Draws, stores BCD digits and ticks the timers, so every part of the state changes
+static const uint8_t bench_rom[] = {
+    0x60, 0x00,     // 200: V0 = 0
+    0x61, 0x00,     // 202: V1 = 0
+    0xA3, 0x00,     // 204: I = 300
+    0xF0, 0x33,     // 206: BCD V0 at I
+    0xF2, 0x65,     // 208: V0-V2 = [I]
+    0xF2, 0x29,     // 20A: I = font V2
+    0xD0, 0x15,     // 20C: draw at V0, V1
+    0x70, 0x03,     // 20E: V0 += 3
+    0x71, 0x01,     // 210: V1 += 1
+    0xF1, 0x15,     // 212: delay = V1
+    0x12, 0x04      // 214: jump 204
+};
+
+static Color display[128 * 64];
+
+// What has to match after a load: screen, registers, I, PC and instruction count
+struct Fingerprint {
+    uint64_t planes[2 * 64 * DISPLAY_ROW_WORDS];
+    uint8_t registers[16];
+    uint16_t i_register;
+    uint16_t program_counter;
+    uint64_t instructions;
+
+    explicit Fingerprint(const Emulator& emulator) {
+        emulator.read_planes(planes);
+        for (uint8_t i = 0; i < 16; i++) {
+            registers[i] = emulator.get_register(i);
+        }
+        i_register = emulator.get_i_register();
+        program_counter = emulator.get_program_counter();
+        instructions = emulator.get_instruction_count();
+    }
+    bool operator==(const Fingerprint& other) const {
+        return std::equal(std::begin(planes), std::end(planes), std::begin(other.planes)) &&
+            std::equal(std::begin(registers), std::end(registers), std::begin(other.registers)) &&
+            i_register == other.i_register && program_counter == other.program_counter && instructions == other.instructions;
+    }
+};
+
+static void report(const char* name, uint32_t count, double seconds) {
+    printf("%-22s %12.0f /s %10.2f us each %10.1f GB/s\n", name, count / seconds, seconds / count * 1e6,
+        (double)count * sizeof(MachineState) / seconds / 1e9);
+}
+
+int main(int argc, char** argv) {
+    uint32_t snapshots = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : BENCH_DEFAULT_SNAPSHOTS;
+    std::vector<uint8_t> rom(std::begin(bench_rom), std::end(bench_rom));
+    if (argc > 2) {
+        std::ifstream file(argv[2], std::ios::binary);
+        if (!file) {
+            printf("Can't read %s\n", argv[2]);
+            return 1;
+        }
+        rom.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    std::cout.setstate(std::ios::failbit);
+
+    auto emulator = std::make_unique<Emulator>(display);
+    emulator->load_rom(rom.data(), (uint32_t)rom.size());
+    emulator->set_cycles_per_frame(BENCH_CYCLES_PER_FRAME);
+    for (int frame = 0; frame < BENCH_WARMUP_FRAMES; frame++) {
+        emulator->run_frame();
+    }
+    printf("State block %zu bytes\n", sizeof(MachineState));
+
+    // A ring of snapshots, like rewind history, so the copies don't all hit one cached block
+    std::vector<MachineState> ring(BENCH_RING);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < snapshots; i++) {
+        emulator->save_state(ring[i % BENCH_RING]);
+    }
+    report("save", snapshots, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    // Loading the state the machine is in keeps the caches, like run ahead going back one frame
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < snapshots; i++) {
+        emulator->load_state(ring[0]);
+    }
+    report("load, same memory", snapshots, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    // Every load changes memory and drops the caches
+    for (int i = 0; i < BENCH_RING; i++) {
+        emulator->run_frame();
+        emulator->save_state(ring[i]);
+    }
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < snapshots; i++) {
+        emulator->load_state(ring[i % BENCH_RING]);
+    }
+    report("load, changed memory", snapshots, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    // Continuing from a loaded state must match continuing from where it was saved, on every engine
+    bool identical = true;
+#if THREADED_SUPPORTED
+    for (Engine engine : { Engine::Interpreter, Engine::BlockCache, Engine::Jit, Engine::Threaded }) {
+#else
+    for (Engine engine : { Engine::Interpreter, Engine::BlockCache, Engine::Jit }) {
+#endif
+        emulator->set_engine(engine);
+        emulator->save_state(ring[0]);
+        for (int frame = 0; frame < BENCH_CHECK_FRAMES; frame++) {
+            emulator->run_frame();
+        }
+        Fingerprint expected(*emulator);
+        emulator->load_state(ring[0]);
+        for (int frame = 0; frame < BENCH_CHECK_FRAMES; frame++) {
+            emulator->run_frame();
+        }
+        if (!(Fingerprint(*emulator) == expected)) {
+            printf("Engine %d diverged after load_state\n", (int)engine);
+            identical = false;
+        }
+    }
+    printf("%s\n", identical ? "Loaded states continue identically" : "MISMATCH");
+
+    // Rewind history, then back through all of it
+    Rewind rewind;
+    std::vector<Fingerprint> history;
+    double capture_seconds = 0;
+    for (int frame = 0; frame < BENCH_REWIND_FRAMES; frame++) {
+        history.emplace_back(*emulator);
+        start = std::chrono::steady_clock::now();
+        rewind.capture(*emulator);
+        capture_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        emulator->run_frame();
+    }
+    printf("%-22s %12.2f us each %10zu bytes per frame, %zu frames kept\n", "rewind capture", capture_seconds / BENCH_REWIND_FRAMES * 1e6,
+        rewind.used() / rewind.frames(), rewind.frames());
+    int rewind_mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = BENCH_REWIND_FRAMES - 1; frame >= 0 && rewind.step_back(*emulator); frame--) {
+        if (!(Fingerprint(*emulator) == history[frame]))
+            rewind_mismatches++;
+    }
+    double step_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-22s %12.2f us each\n", "rewind step back", step_seconds / BENCH_REWIND_FRAMES * 1e6);
+    if (rewind_mismatches) {
+        printf("%d rewound frames differ from the recorded ones\n", rewind_mismatches);
+        identical = false;
+    }
+    return identical ? 0 : 1;
+}
@@ -9,7 +9,7 @@
 #include <stdlib.h>         // abort
 #include <vector>
 #include <vulkan.h>
-#include "Emulator.h"
+#include "Debugger.h"
 
 static void check_vk_result(VkResult err)
 {
@@ -109,7 +109,7 @@ void Gui::present(VulkanEngine* engine, uint32_t index) {
     //window_data->SemaphoreIndex = (window_data->SemaphoreIndex + 1) % window_data->ImageCount; // Now we can use the next set of semaphores
 }
 
-void Gui::render(VulkanEngine* engine, Emulator& emulator) {
+void Gui::render(VulkanEngine* engine, Debugger& debugger) {
     // Start the Dear ImGui frame
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplSDL2_NewFrame();
@@ -127,7 +127,7 @@ void Gui::render(VulkanEngine* engine, Emulator& emulator) {
         ImGui::End();
     }
 
-    emulator.render();
+    debugger.render();
 
     // Rendering
     ImGui::Render();
@@ -1,6 +1,6 @@
 #pragma once
 #include "vk_engine.h"
-#include "Emulator.h"
+#include "Debugger.h"
 #include "imgui.h"
 #include "imgui_impl_vulkan.h"
 #include <vulkan.h>
@@ -14,5 +14,5 @@ private:
     void draw(ImDrawData* draw_data, VulkanEngine* engine, uint32_t index);
     void present(VulkanEngine* engine, uint32_t index);
 public:
-    void render(VulkanEngine* engine, Emulator& emulator);
+    void render(VulkanEngine* engine, Debugger& debugger);
 };
\ No newline at end of file
@@ -0,0 +1,29 @@
+# Builds AOT modules for the engine_test ROMs with ch8aot and the C++ compiler, then runs engine_test with
+# the AOT engine included. Run by ctest, see CMakeLists.txt for the variables it is given.
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/aot)
+execute_process(COMMAND ${ENGINE_TEST} --write-roms ${WORK_DIR} RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "engine_test couldn't write its ROMs")
+endif()
+
+file(GLOB roms ${WORK_DIR}/*.ch8)
+foreach(rom ${roms})
+    get_filename_component(name ${rom} NAME_WE)
+    execute_process(COMMAND ${CH8AOT} ${rom} ${WORK_DIR}/${name}.cpp OUTPUT_VARIABLE output RESULT_VARIABLE result)
+    # ch8aot names the library to build, aot/<hash>.so
+    string(REGEX MATCH "aot/[0-9a-f]+\\.so" module "${output}")
+    if(result OR NOT module)
+        message(FATAL_ERROR "ch8aot failed on ${rom}: ${output}")
+    endif()
+    execute_process(COMMAND ${CXX} -O1 -shared -fPIC -I${SOURCE_DIR} ${WORK_DIR}/${name}.cpp -o ${WORK_DIR}/${module}
+        RESULT_VARIABLE result)
+    if(result)
+        message(FATAL_ERROR "Can't build the AOT module for ${rom}")
+    endif()
+endforeach()
+
+execute_process(COMMAND ${ENGINE_TEST} --aot WORKING_DIRECTORY ${WORK_DIR} RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "AOT engine differs from the interpreter")
+endif()
@@ -0,0 +1,177 @@
+// Engine equivalence test: runs small ROMs on every engine long enough for their loops to get hot and be
+// compiled, then checks each engine left the machine exactly as the interpreter did. Registers, I, PC,
+// instruction count and the screen are compared, the screen also as read_changed_planes builds it up
+// between runs. Returns non zero on any difference.
+//
+//   engine_test [--write-roms directory] [--aot]
+//
+// --write-roms saves the ROMs as rom<n>.ch8 for tools/ch8aot. --aot also checks the AOT engine, run it
+// where ./aot holds the modules built from them. tests/aot_test.cmake does both.
+#include "Emulator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define TEST_CYCLES 10000
+#define TEST_CHUNK 97               // Instructions between read_changed_planes calls
+
+struct EngineTestRom {
+    const char* name;
+    std::vector<uint8_t> data;
+};
+
+static const EngineTestRom roms[] = {
+    // F000 reads its operand at PC, compiled code must not move PC past it first
+    { "long i", {
+        0xF0, 0x00, 0x03, 0x00,     // 200: I = 0300
+        0x12, 0x00                  // 204: jump 200
+    } },
+    { "long i between ops", {
+        0x70, 0x01,                 // 200: V0 += 1
+        0xF0, 0x00, 0x03, 0x10,     // 202: I = 0310
+        0xF1, 0x1E,                 // 206: I += V1
+        0x71, 0x01,                 // 208: V1 += 1
+        0xF0, 0x00, 0x03, 0x00,     // 20A: I = 0300
+        0xF0, 0x33,                 // 20E: BCD V0 at I
+        0xF2, 0x65,                 // 210: V0-V2 = [I]
+        0x81, 0x24,                 // 212: V1 += V2
+        0x12, 0x00                  // 214: jump 200
+    } },
+    // Skips step over the whole 4 byte F000
+    { "skip long i", {
+        0x70, 0x01,                 // 200: V0 += 1
+        0x60, 0x01,                 // 202: V0 = 1
+        0x30, 0x01,                 // 204: skip if V0 == 1
+        0xF0, 0x00, 0x04, 0x00,     // 206: I = 0400
+        0x40, 0x01,                 // 20A: skip if V0 != 1
+        0xF0, 0x00, 0x05, 0x00,     // 20C: I = 0500
+        0x71, 0x01,                 // 210: V1 += 1
+        0x12, 0x00                  // 212: jump 200
+    } },
+    // Rewrites the operand of the F000 after it on every pass
+    { "patched long i", {
+        0xA2, 0x09,                 // 200: I = 209
+        0x70, 0x01,                 // 202: V0 += 1
+        0xF0, 0x55,                 // 204: [I] = V0
+        0xF0, 0x00, 0x03, 0x00,     // 206: I = 03V0
+        0x12, 0x00                  // 20A: jump 200
+    } },
+    { "draw", {
+        0x00, 0xFF,                 // 200: high resolution
+        0xF0, 0x00, 0x02, 0x00,     // 202: I = 0200, the code doubles as sprite data
+        0xD0, 0x15,                 // 206: draw at V0, V1
+        0x70, 0x05,                 // 208: V0 += 5
+        0x71, 0x03,                 // 20A: V1 += 3
+        0x12, 0x02                  // 20C: jump 202
+    } },
+    // Native low resolution planes, scrolled by whole and half pixels
+    { "lores scroll", {
+        0xA2, 0x00,                 // 200: I = 200
+        0xD0, 0x15,                 // 202: draw at V0, V1
+        0x00, 0xC2,                 // 204: scroll down 2
+        0x00, 0xFB,                 // 206: scroll right 4
+        0x70, 0x03,                 // 208: V0 += 3
+        0x00, 0xD1,                 // 20A: scroll up 1
+        0x71, 0x01,                 // 20C: V1 += 1
+        0x12, 0x02                  // 20E: jump 202
+    } },
+};
+
+struct Fingerprint {
+    uint8_t registers[16];
+    uint16_t i_register;
+    uint16_t program_counter;
+    uint64_t instruction_count;
+    std::vector<uint64_t> planes;
+
+    explicit Fingerprint(const Emulator& emulator) : planes(2 * 64 * DISPLAY_ROW_WORDS) {
+        for (uint8_t i = 0; i < 16; i++) {
+            registers[i] = emulator.get_register(i);
+        }
+        i_register = emulator.get_i_register();
+        program_counter = emulator.get_program_counter();
+        instruction_count = emulator.get_instruction_count();
+        emulator.read_planes(planes.data());
+    }
+};
+
+static Color display[128 * 64];
+
+static const char* engine_names[] = { "interpreter", "blocks", "jit", "aot", "threaded" };
+
+static bool write_roms(const char* directory) {
+    for (size_t i = 0; i < sizeof(roms) / sizeof(roms[0]); i++) {
+        std::string path = std::string(directory) + "/rom" + std::to_string(i) + ".ch8";
+        std::ofstream file(path, std::ios::binary);
+        file.write((const char*)roms[i].data.data(), roms[i].data.size());
+        if (!file) {
+            printf("Can't write %s\n", path.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool aot = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--write-roms") == 0 && i + 1 < argc)
+            return write_roms(argv[++i]) ? 0 : 1;
+        else if (strcmp(argv[i], "--aot") == 0)
+            aot = true;
+        else {
+            printf("usage: engine_test [--write-roms directory] [--aot]\n");
+            return 1;
+        }
+    }
+    // The emulator logs ROM loads
+    std::cout.setstate(std::ios::failbit);
+
+    std::vector<Engine> engines = { Engine::BlockCache, Engine::Jit };
+#if THREADED_SUPPORTED
+    engines.push_back(Engine::Threaded);
+#endif
+    if (aot)
+        engines.push_back(Engine::Aot);
+    int failures = 0;
+    for (const EngineTestRom& rom : roms) {
+        Emulator reference{ display };
+        reference.load_rom(rom.data.data(), (uint32_t)rom.data.size());
+        reference.run_cycles(TEST_CYCLES);
+        Fingerprint expected(reference);
+        for (Engine engine : engines) {
+            Emulator emulator{ display };
+            emulator.load_rom(rom.data.data(), (uint32_t)rom.data.size());
+            emulator.set_engine(engine);
+            std::vector<uint64_t> changed(expected.planes.size());
+            // Without its module the AOT engine interprets and would pass without testing anything
+            if (engine == Engine::Aot && !emulator.has_aot_module()) {
+                printf("%s has no AOT module\n", rom.name);
+                failures++;
+                continue;
+            }
+            for (uint32_t done = 0; done < TEST_CYCLES; done += TEST_CHUNK) {
+                emulator.run_cycles(std::min<uint32_t>(TEST_CHUNK, TEST_CYCLES - done));
+                emulator.read_changed_planes(changed.data());
+            }
+            Fingerprint actual(emulator);
+            bool same = memcmp(actual.registers, expected.registers, sizeof(expected.registers)) == 0 &&
+                actual.i_register == expected.i_register && actual.program_counter == expected.program_counter &&
+                actual.instruction_count == expected.instruction_count && actual.planes == expected.planes &&
+                changed == expected.planes;
+            if (!same) {
+                printf("%s on %s: PC %03X I %03X V0 %02X, interpreter PC %03X I %03X V0 %02X\n", rom.name,
+                    engine_names[(int)engine], actual.program_counter, actual.i_register, actual.registers[0],
+                    expected.program_counter, expected.i_register, expected.registers[0]);
+                failures++;
+            }
+        }
+    }
+    printf("%s\n", failures ? "FAILED" : "all engines match");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+// Ahead-of-time recompiler: discovers the code reachable from 0x200 in a ROM and writes a C++ module
+// with one function per basic block. Build the output as a shared library named after the ROM hash
+// and place it in the Emulator's aot directory, the AOT engine then runs that ROM from it:
+//
+//   ch8aot game.ch8 game_aot.cpp
+//   g++ -O2 -shared -fPIC -I<repository> game_aot.cpp -o aot/<hash>.so
+//
+// Stores end a block, as they do in the BlockCache, so a ROM that writes into its own code is caught
+// before any stale code runs. The Emulator then drops the module and falls back to interpreting.
+// BNNN and any other target that can't be found statically also run on the interpreter until
+// execution reaches a compiled block again.
+#include "AotAbi.h"
+#include "Decoder.h"
+#include "Hash.h"
+#include "MachineState.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#define ROM_START 0x200
+#define ROM_MEM_SIZE 0x10000
+
+struct Rom {
+    std::vector<uint8_t> memory = std::vector<uint8_t>(ROM_MEM_SIZE, 0);
+    uint32_t size = 0;
+
+    bool contains(uint32_t address) const { return address >= ROM_START && address + 1 < ROM_START + size; }
+    uint16_t opcode_at(uint32_t address) const {
+        return (memory[address % ROM_MEM_SIZE] << 8) | memory[(address + 1) % ROM_MEM_SIZE];
+    }
+};
+
+static uint32_t instruction_size(const Rom& rom, uint32_t address) {
+    return decode_kind(rom.opcode_at(address)) == OpKind::LoadLongI ? 4 : 2;
+}
+
+// Where a skip lands when it is taken, stepping over F000 as a whole
+static uint32_t skip_target(const Rom& rom, uint32_t next) {
+    return next + (rom.opcode_at(next) == 0xF000 ? 4 : 2);
+}
+
+static bool ends_block(OpKind kind) {
+    switch (kind) {
+    case OpKind::Return:
+    case OpKind::Exit:
+    case OpKind::Jump:
+    case OpKind::Call:
+    case OpKind::SkipEqImm:
+    case OpKind::SkipNeImm:
+    case OpKind::SkipEqReg:
+    case OpKind::SkipNeReg:
+    case OpKind::JumpV0:
+    case OpKind::SkipKey:
+    case OpKind::SkipNotKey:
+    case OpKind::WaitKey:
+    case OpKind::SaveRange:
+    case OpKind::Bcd:
+    case OpKind::Store:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void discover(const Rom& rom, std::set<uint32_t>& code, std::set<uint32_t>& leaders) {
+    std::vector<uint32_t> worklist{ ROM_START };
+    leaders.insert(ROM_START);
+    auto branch = [&](uint32_t target) {
+        leaders.insert(target);
+        worklist.push_back(target);
+    };
+    while (!worklist.empty()) {
+        uint32_t address = worklist.back();
+        worklist.pop_back();
+        if (!rom.contains(address) || !code.insert(address).second)
+            continue;
+
+        uint16_t opcode = rom.opcode_at(address);
+        uint32_t next = address + instruction_size(rom, address);
+        switch (decode_kind(opcode)) {
+        case OpKind::Jump:
+            branch(opcode & 0x0FFF);
+            break;
+        case OpKind::Call:
+            branch(opcode & 0x0FFF);
+            branch(next);
+            break;
+        case OpKind::SkipEqImm:
+        case OpKind::SkipNeImm:
+        case OpKind::SkipEqReg:
+        case OpKind::SkipNeReg:
+        case OpKind::SkipKey:
+        case OpKind::SkipNotKey:
+            branch(next);
+            branch(skip_target(rom, next));
+            break;
+        case OpKind::WaitKey:
+        case OpKind::Exit:
+        case OpKind::SaveRange:
+        case OpKind::Bcd:
+        case OpKind::Store:
+            branch(next);
+            break;
+        case OpKind::Return:
+        case OpKind::JumpV0:
+            break;
+        default:
+            worklist.push_back(next);
+        }
+    }
+}
+
+static void emit_op(std::ostream& out, const Rom& rom, uint32_t address) {
+    uint16_t opcode = rom.opcode_at(address);
+    Op op = decode_operands(opcode, nullptr);
+    OpKind kind = decode_kind(opcode);
+    uint16_t next = (uint16_t)(address + instruction_size(rom, address));
+    char line[160];
+    auto emit = [&](const char* format, auto... arguments) {
+        snprintf(line, sizeof(line), format, arguments...);
+        out << "    " << line << "\n";
+    };
+    auto skip = [&](const char* condition) {
+        emit("*s->program_counter = (%s) ? (peek(s, 0x%04X) == 0xF000 ? 0x%04X : 0x%04X) : 0x%04X;",
+            condition, next, (uint16_t)(next + 4), (uint16_t)(next + 2), next);
+    };
+    char condition[64];
+
+    switch (kind) {
+    case OpKind::Jump:
+        emit("*s->program_counter = 0x%04X;", op.NNN);
+        break;
+    case OpKind::Call:
+        emit("s->stack[(*s->stack_pointer)++] = 0x%04X;", next);
+        emit("*s->program_counter = 0x%04X;", op.NNN);
+        break;
+    case OpKind::Return:
+        emit("*s->program_counter = s->stack[--(*s->stack_pointer)];");
+        break;
+    case OpKind::JumpV0:
+        emit("*s->program_counter = (uint16_t)(0x%04X + V[0x0]);", op.NNN);
+        break;
+    case OpKind::SkipEqImm:
+    case OpKind::SkipNeImm:
+        snprintf(condition, sizeof(condition), "V[0x%X] %s 0x%02X", op.X, kind == OpKind::SkipEqImm ? "==" : "!=", op.NN);
+        skip(condition);
+        break;
+    case OpKind::SkipEqReg:
+    case OpKind::SkipNeReg:
+        snprintf(condition, sizeof(condition), "V[0x%X] %s V[0x%X]", op.X, kind == OpKind::SkipEqReg ? "==" : "!=", op.Y);
+        skip(condition);
+        break;
+    case OpKind::LoadImm:
+        emit("V[0x%X] = 0x%02X;", op.X, op.NN);
+        break;
+    case OpKind::AddImm:
+        emit("V[0x%X] += 0x%02X;", op.X, op.NN);
+        break;
+    case OpKind::Move:
+        emit("V[0x%X] = V[0x%X];", op.X, op.Y);
+        break;
+    case OpKind::Or:
+        emit("V[0x%X] |= V[0x%X];", op.X, op.Y);
+        break;
+    case OpKind::And:
+        emit("V[0x%X] &= V[0x%X];", op.X, op.Y);
+        break;
+    case OpKind::Xor:
+        emit("V[0x%X] ^= V[0x%X];", op.X, op.Y);
+        break;
+    case OpKind::AddReg:
+        emit("V[0x%X] += V[0x%X];", op.X, op.Y);
+        emit("V[0xF] = V[0x%X] < V[0x%X] ? 1 : 0;", op.X, op.Y);
+        break;
+    case OpKind::SubReg:
+        emit("{ uint8_t previous = V[0x%X]; V[0x%X] = previous - V[0x%X]; V[0xF] = V[0x%X] <= previous ? 1 : 0; }", op.X, op.X, op.Y, op.X);
+        break;
+    case OpKind::ShiftRight:
+        emit("{ uint8_t flag = V[0x%X] & 0x01; V[0x%X] = V[0x%X] >> 1; V[0xF] = flag; }", op.Y, op.X, op.Y);
+        break;
+    case OpKind::SubnReg:
+        emit("V[0x%X] = V[0x%X] - V[0x%X];", op.X, op.Y, op.X);
+        emit("V[0xF] = V[0x%X] <= V[0x%X] ? 1 : 0;", op.X, op.Y);
+        break;
+    case OpKind::ShiftLeft:
+        emit("{ uint8_t flag = V[0x%X] >> 7; V[0x%X] = V[0x%X] << 1; V[0xF] = flag; }", op.Y, op.X, op.Y);
+        break;
+    case OpKind::LoadI:
+        emit("*s->i_register = 0x%04X;", op.NNN);
+        break;
+    case OpKind::AddI:
+        emit("*s->i_register += V[0x%X];", op.X);
+        break;
+    default:
+        // Everything else goes through the Emulator's own handler, with PC where execute() leaves it.
+        // F000 reads its operand there and steps over it itself.
+        if (kind == OpKind::LoadLongI) {
+            emit("*s->program_counter = 0x%04X;", (uint16_t)(address + 2));
+            emit("s->execute(s->emulator, 0x%04X);", opcode);
+            emit("*s->program_counter = 0x%04X;", next);
+        }
+        else {
+            emit("*s->program_counter = 0x%04X;", next);
+            emit("s->execute(s->emulator, 0x%04X);", opcode);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: ch8aot <rom.ch8> <output.cpp>" << std::endl;
+        return 1;
+    }
+
+    Rom rom;
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+        std::cout << "Can't open " << argv[1] << std::endl;
+        return 1;
+    }
+    // Same limit as Emulator::load_file
+    file.read((char*)rom.memory.data() + ROM_START, MAX_ROM_SIZE);
+    rom.size = (uint32_t)file.gcount();
+    uint64_t hash = fnv1a(rom.memory.data() + ROM_START, rom.size);
+
+    std::set<uint32_t> code;
+    std::set<uint32_t> leaders;
+    discover(rom, code, leaders);
+
+    std::ostringstream out;
+    out << "// Generated by ch8aot from " << argv[1] << ", do not edit\n";
+    out << "#include \"AotAbi.h\"\n\n";
+    out << "static inline uint16_t peek(AotState* s, uint16_t address) {\n";
+    out << "    return (s->memory[address] << 8) | s->memory[(uint16_t)(address + 1)];\n";
+    out << "}\n\n";
+
+    std::ostringstream table;
+    uint32_t block_count = 0;
+    for (uint32_t start : leaders) {
+        if (!code.count(start))
+            continue;
+        out << "static void block_" << std::hex << start << std::dec << "(AotState* s) {\n";
+        out << "    uint8_t* V = s->registers;\n";
+        out << "    (void)V;\n";
+
+        uint32_t address = start;
+        uint32_t length = 0;
+        bool terminated = false;
+        do {
+            emit_op(out, rom, address);
+            terminated = ends_block(decode_kind(rom.opcode_at(address)));
+            address += instruction_size(rom, address);
+            length++;
+        } while (!terminated && code.count(address) && !leaders.count(address));
+        if (!terminated) {
+            char line[64];
+            snprintf(line, sizeof(line), "    *s->program_counter = 0x%04X;\n", address);
+            out << line;
+        }
+        out << "}\n\n";
+
+        char entry[96];
+        snprintf(entry, sizeof(entry), "    { 0x%04X, 0x%04X, %u, block_%x },\n", start, address, length, start);
+        table << entry;
+        block_count++;
+    }
+
+    out << "static const AotBlock blocks[] = {\n" << table.str() << "};\n\n";
+    char hash_string[32];
+    snprintf(hash_string, sizeof(hash_string), "0x%016llxull", (unsigned long long)hash);
+    out << "static const AotModule module = { AOT_ABI_VERSION, " << hash_string << ", " << rom.size << ", " << block_count << ", blocks };\n\n";
+    out << "AOT_EXPORT const AotModule* chip8_aot_module() {\n";
+    out << "    return &module;\n";
+    out << "}\n";
+
+    std::ofstream output(argv[2]);
+    output << out.str();
+    if (!output) {
+        std::cout << "Can't write " << argv[2] << std::endl;
+        return 1;
+    }
+    snprintf(hash_string, sizeof(hash_string), "%016llx", (unsigned long long)hash);
+    std::cout << "Wrote " << block_count << " blocks covering " << code.size() << " instructions" << std::endl;
+    std::cout << "Build it as aot/" << hash_string << ".so (aot\\" << hash_string << ".dll on Windows)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,118 @@
+// ROM packer: writes ROM files into one pack for ch8run and RomPack, or lists what a pack holds.
+//
+//   ch8pack <output.c8p> <rom or directory>...
+//   ch8pack --list <pack.c8p>
+//
+// Directories are searched recursively for .ch8 files, which are named by their path below the
+// directory. ROMs given directly are named by their file name. Names must be unique.
+#include "Hash.h"
+#include "MachineState.h"
+#include "RomPack.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct PackRom {
+    std::string name;
+    std::string path;
+};
+
+static void usage() {
+    printf("usage: ch8pack <output.c8p> <rom or directory>...\n"
+           "       ch8pack --list <pack.c8p>\n");
+}
+
+static void put_le(std::vector<uint8_t>& out, size_t at, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[at + i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static int list(const char* path) {
+    RomPack pack;
+    if (!pack.open(path))
+        return 1;
+    for (size_t i = 0; i < pack.size(); i++) {
+        printf("%016llx %6u  %s\n", (unsigned long long)pack.rom_hash(i), pack.rom_size(i), pack.name(i).c_str());
+    }
+    printf("%zu ROMs\n", pack.size());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && strcmp(argv[1], "--list") == 0)
+        return list(argv[2]);
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+
+    std::vector<PackRom> roms;
+    for (int i = 2; i < argc; i++) {
+        std::filesystem::path input(argv[i]);
+        std::error_code error;
+        if (std::filesystem::is_directory(input, error)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(input, error)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".ch8")
+                    roms.push_back({ entry.path().lexically_relative(input).generic_string(), entry.path().string() });
+            }
+        }
+        else
+            roms.push_back({ input.filename().string(), input.string() });
+        if (error) {
+            printf("Can't read %s: %s\n", argv[i], error.message().c_str());
+            return 1;
+        }
+    }
+    // The index is searched by name
+    std::sort(roms.begin(), roms.end(), [](const PackRom& a, const PackRom& b) { return a.name < b.name; });
+    for (size_t i = 1; i < roms.size(); i++) {
+        if (roms[i].name == roms[i - 1].name) {
+            printf("Two ROMs are called %s: %s and %s\n", roms[i].name.c_str(), roms[i - 1].path.c_str(), roms[i].path.c_str());
+            return 1;
+        }
+    }
+
+    // Header, index and names, then the ROMs. Index entries are laid out as RomPackEntry.
+    std::vector<uint8_t> pack(16 + roms.size() * sizeof(RomPackEntry));
+    memcpy(pack.data(), ROM_PACK_MAGIC, 8);
+    put_le(pack, 8, ROM_PACK_VERSION, 4);
+    put_le(pack, 12, roms.size(), 4);
+    for (size_t i = 0; i < roms.size(); i++) {
+        size_t entry = 16 + i * sizeof(RomPackEntry);
+        put_le(pack, entry + offsetof(RomPackEntry, name_offset), pack.size(), 4);
+        put_le(pack, entry + offsetof(RomPackEntry, name_length), roms[i].name.size(), 4);
+        pack.insert(pack.end(), roms[i].name.begin(), roms[i].name.end());
+    }
+    for (size_t i = 0; i < roms.size(); i++) {
+        MappedFile file;
+        if (!file.open(roms[i].path.c_str())) {
+            printf("Can't read %s\n", roms[i].path.c_str());
+            return 1;
+        }
+        // Stored as Emulator::load_rom keeps them, so the hash is the loaded ROM's rom_hash
+        size_t size = std::min<size_t>(file.size(), MAX_ROM_SIZE);
+        pack.resize((pack.size() + ROM_PACK_ALIGNMENT - 1) / ROM_PACK_ALIGNMENT * ROM_PACK_ALIGNMENT);
+        size_t entry = 16 + i * sizeof(RomPackEntry);
+        put_le(pack, entry + offsetof(RomPackEntry, hash), fnv1a(file.data(), size), 8);
+        put_le(pack, entry + offsetof(RomPackEntry, offset), pack.size(), 8);
+        put_le(pack, entry + offsetof(RomPackEntry, size), size, 4);
+        pack.insert(pack.end(), file.data(), file.data() + size);
+    }
+
+    FILE* output = fopen(argv[1], "wb");
+    if (!output || fwrite(pack.data(), 1, pack.size(), output) != pack.size()) {
+        printf("Can't write %s\n", argv[1]);
+        if (output)
+            fclose(output);
+        return 1;
+    }
+    fclose(output);
+    printf("%zu ROMs, %zu bytes\n", roms.size(), pack.size());
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Headless movie player: replays a movie recorded in the debugger as fast as the engine runs and prints
+// the final framebuffer hash, so a reported session can be reproduced and compared between builds.
+//
+//   ch8replay <movie> [--engine name] [--rom rom.ch8] [--trace file] [--profile]
+//
+// The movie carries the whole initial machine, memory included, so the ROM is only needed to check
+// that the movie was recorded with it. --trace records every instruction for tools/ch8trace, the run then
+// goes through the interpreter whatever the engine. So does --profile, which prints the hottest addresses
+// and the host time per kind of instruction.
+#include "Emulator.h"
+#include "Hash.h"
+#include "Movie.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+static const char* engine_names[] = { "interpreter", "blocks", "jit", "aot", "threaded" };
+
+static bool parse_engine(const char* name, Engine& engine) {
+    for (size_t i = 0; i < sizeof(engine_names) / sizeof(engine_names[0]); i++) {
+        if (strcmp(name, engine_names[i]) == 0) {
+            engine = (Engine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void usage() {
+    printf("usage: ch8replay <movie> [--engine name] [--rom rom.ch8] [--trace file] [--profile]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    Engine engine = Engine::Interpreter;
+    const char* rom_path = nullptr;
+    const char* trace_path = nullptr;
+    bool profile = false;
+    for (int i = 2; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--rom") == 0 && has_value)
+            rom_path = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0)
+            profile = true;
+        else if (strcmp(argv[i], "--trace") == 0 && has_value)
+            trace_path = argv[++i];
+        else if (strcmp(argv[i], "--engine") == 0 && has_value) {
+            if (!parse_engine(argv[++i], engine)) {
+                printf("Unknown engine %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    Movie movie;
+    if (!movie.load(argv[1]))
+        return 1;
+    if (rom_path) {
+        std::ifstream file(rom_path, std::ios::binary);
+        if (!file) {
+            printf("Can't read %s\n", rom_path);
+            return 1;
+        }
+        std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        // Same limit as Emulator::load_file
+        if (rom.size() > MAX_ROM_SIZE)
+            rom.resize(MAX_ROM_SIZE);
+        if (fnv1a(rom.data(), rom.size()) != movie.rom_hash) {
+            printf("Movie was recorded with a different ROM\n");
+            return 1;
+        }
+    }
+
+    std::vector<Color> display(128 * 64);
+    Emulator emulator{ display.data() };
+    emulator.set_engine(engine);
+    movie.start(emulator);
+#if CHIP8_TRACE
+    Tracer tracer;
+    if (trace_path) {
+        if (!tracer.start(trace_path))
+            return 1;
+        emulator.set_tracer(&tracer);
+    }
+#else
+    if (trace_path) {
+        printf("Built without CHIP8_TRACE\n");
+        return 1;
+    }
+#endif
+    auto profiler = std::make_unique<Profiler>();
+    if (profile)
+        emulator.set_profiler(profiler.get());
+    std::cout.setstate(std::ios::failbit);
+
+    // The count carries on from the recorded session
+    uint64_t first_instruction = emulator.get_instruction_count();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t frames = 0;
+    while (movie.play_frame(emulator)) {
+        frames++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    emulator.sync_display();
+#if CHIP8_TRACE
+    std::cout.clear();
+    emulator.set_tracer(nullptr);
+    tracer.stop();
+#endif
+    uint64_t instructions = emulator.get_instruction_count() - first_instruction;
+
+    printf("rom %016llx, %llu frames of %u cycles, %llu instructions in %.3f s (%.1f MIPS, %.0fx real time)\n",
+        (unsigned long long)movie.rom_hash, (unsigned long long)frames, movie.cycles_per_frame,
+        (unsigned long long)instructions, seconds, instructions / seconds / 1e6,
+        frames / (double)FRAME_RATE / seconds);
+    printf("display %016llx\n", (unsigned long long)fnv1a((const uint8_t*)display.data(), display.size() * sizeof(Color)));
+    if (profile) {
+        std::vector<Hotspot> hotspots;
+        profiler->hotspots(16, hotspots);
+        printf("\naddress  executions  share\n");
+        for (const Hotspot& hotspot : hotspots) {
+            printf("%04X     %10llu  %5.1f%%\n", hotspot.address, (unsigned long long)hotspot.executions, 100.0 * hotspot.executions / instructions);
+        }
+        printf("\nkind         executions   ns each\n");
+        for (int kind = 0; kind < (int)OpKind::Count; kind++) {
+            uint64_t count = profiler->kind_executions[kind];
+            if (count)
+                printf("%-11s %11llu  %8.2f\n", op_kind_names[kind], (unsigned long long)count, profiler->kind_ns((OpKind)kind));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Headless corpus runner: loads every .ch8 file in a directory or every ROM in a pack, runs each one
+// for a fixed budget on all cores and writes a JSON report with the final framebuffer hash, instruction
+// and unimplemented opcode counts and wall time per ROM. Compare reports between builds to catch
+// regressions.
+//
+//   ch8run <rom directory or pack> [--frames N | --cycles N] [--cycles-per-frame N] [--engine name]
+//          [--threads N] [--output report.json]
+//
+// Engines are interpreter, blocks, jit, aot and threaded. ROMs stopping with 00FD end early. Packs are
+// written by tools/ch8pack, they load faster than thousands of loose files.
+#include "Emulator.h"
+#include "Hash.h"
+#include "RomPack.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define RUN_DEFAULT_FRAMES 600
+#define RUN_DEFAULT_CYCLES_PER_FRAME 1000
+
+struct RomResult {
+    std::string path;           // Name in the pack for packed ROMs
+    long pack_index;            // -1 for loose files
+    uint64_t frames;
+    uint64_t instructions;
+    uint32_t unknown_opcodes;
+    uint64_t display_hash;
+    bool exited;
+    double wall_ms;
+};
+
+struct RunOptions {
+    uint64_t cycles;            // Total instruction budget, cycles_per_frame * frames unless --cycles is given
+    uint32_t cycles_per_frame;
+    Engine engine;
+};
+
+static const char* engine_names[] = { "interpreter", "blocks", "jit", "aot", "threaded" };
+
+static bool parse_engine(const char* name, Engine& engine) {
+    for (size_t i = 0; i < sizeof(engine_names) / sizeof(engine_names[0]); i++) {
+        if (strcmp(name, engine_names[i]) == 0) {
+            engine = (Engine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_rom(const RunOptions& options, const RomPack& pack, RomResult& result) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Color> display(128 * 64);
+    Emulator emulator{ display.data() };
+    if (result.pack_index >= 0)
+        emulator.load_rom(pack.rom(result.pack_index), pack.rom_size(result.pack_index));
+    else
+        emulator.load_file(result.path.c_str());
+    emulator.set_engine(options.engine);
+    emulator.set_cycles_per_frame(options.cycles_per_frame);
+
+    result.frames = 0;
+    for (uint64_t left = options.cycles; left && !emulator.is_paused(); result.frames++) {
+        // The last frame of a --cycles budget may be a short one
+        uint32_t cycles = (uint32_t)std::min<uint64_t>(left, options.cycles_per_frame);
+        emulator.set_cycles_per_frame(cycles);
+        emulator.run_frame();
+        left -= cycles;
+    }
+    emulator.sync_display();
+
+    result.instructions = emulator.get_instruction_count();
+    result.unknown_opcodes = emulator.get_unknown_opcode_count();
+    result.display_hash = fnv1a((const uint8_t*)display.data(), display.size() * sizeof(Color));
+    result.exited = emulator.is_paused();
+    result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string json_string(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if ((unsigned char)c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped + "\"";
+}
+
+static void usage() {
+    printf("usage: ch8run <rom directory or pack> [--frames N | --cycles N] [--cycles-per-frame N] [--engine name]\n"
+           "              [--threads N] [--output report.json]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    const char* directory = argv[1];
+    uint64_t frames = RUN_DEFAULT_FRAMES;
+    uint64_t cycles = 0;
+    unsigned threads = 0;
+    const char* output_path = nullptr;
+    RunOptions options{ 0, RUN_DEFAULT_CYCLES_PER_FRAME, Engine::Interpreter };
+    for (int i = 2; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--frames") == 0 && has_value)
+            frames = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--cycles") == 0 && has_value)
+            cycles = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--cycles-per-frame") == 0 && has_value)
+            options.cycles_per_frame = (uint32_t)std::min<uint64_t>(strtoull(argv[++i], nullptr, 10), MAX_CYCLES_PER_FRAME);
+        else if (strcmp(argv[i], "--threads") == 0 && has_value)
+            threads = (unsigned)strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--output") == 0 && has_value)
+            output_path = argv[++i];
+        else if (strcmp(argv[i], "--engine") == 0 && has_value) {
+            if (!parse_engine(argv[++i], options.engine)) {
+                printf("Unknown engine %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (options.cycles_per_frame == 0)
+        options.cycles_per_frame = 1;
+    options.cycles = cycles ? cycles : frames * options.cycles_per_frame;
+
+    std::vector<RomResult> results;
+    RomPack pack;
+    std::error_code error;
+    if (std::filesystem::is_regular_file(directory, error)) {
+        if (!pack.open(directory))
+            return 1;
+        for (size_t i = 0; i < pack.size(); i++) {
+            results.push_back(RomResult{ pack.name(i), (long)i, 0, 0, 0, 0, false, 0 });
+        }
+    }
+    else {
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".ch8")
+                results.push_back(RomResult{ entry.path().string(), -1, 0, 0, 0, 0, false, 0 });
+        }
+    }
+    if (error) {
+        printf("Can't read %s: %s\n", directory, error.message().c_str());
+        return 1;
+    }
+    // Directory order is unspecified, sort so reports from different builds line up. Packs are sorted already.
+    std::sort(results.begin(), results.end(), [](const RomResult& a, const RomResult& b) { return a.path < b.path; });
+
+    // The Emulator logs loads and unimplemented opcodes, which would interleave between threads
+    std::cout.setstate(std::ios::failbit);
+    WorkStealingPool pool(threads);
+    auto start = std::chrono::steady_clock::now();
+    pool.run(results.size(), [&](size_t i) { run_rom(options, pack, results[i]); });
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    FILE* output = output_path ? fopen(output_path, "w") : stdout;
+    if (!output) {
+        printf("Can't write %s\n", output_path);
+        return 1;
+    }
+    fprintf(output, "{\n  \"engine\": \"%s\",\n  \"threads\": %u,\n  \"cycles\": %llu,\n"
+        "  \"cycles_per_frame\": %u,\n  \"wall_ms\": %.3f,\n  \"roms\": [",
+        engine_names[(size_t)options.engine], pool.size(), (unsigned long long)options.cycles,
+        options.cycles_per_frame, wall_ms);
+    for (size_t i = 0; i < results.size(); i++) {
+        const RomResult& result = results[i];
+        fprintf(output, "%s\n    { \"rom\": %s, \"frames\": %llu, \"instructions\": %llu, "
+            "\"unknown_opcodes\": %u, \"display_hash\": \"%016llx\", \"exited\": %s, \"wall_ms\": %.3f }",
+            i ? "," : "", json_string(result.path).c_str(), (unsigned long long)result.frames,
+            (unsigned long long)result.instructions, result.unknown_opcodes,
+            (unsigned long long)result.display_hash, result.exited ? "true" : "false", result.wall_ms);
+    }
+    fprintf(output, "\n  ]\n}\n");
+    if (output != stdout)
+        fclose(output);
+    return 0;
+}
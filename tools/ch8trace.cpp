@@ -0,0 +1,108 @@
+// Trace decoder: prints an instruction trace written by Tracer, one instruction per line, or with --summary
+// how often each kind of instruction ran. Gaps in the sequence, where the writer fell behind and records
+// were dropped, are reported in both.
+//
+//   ch8trace <trace> [--summary] [--from N] [--count N]
+//
+// Registers the instruction changed are printed with their new value when it is VX or VF, the record
+// only carries those two, and by name otherwise (FX65, 5XY3).
+#include "Decoder.h"
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void usage() {
+    printf("usage: ch8trace <trace> [--summary] [--from N] [--count N]\n");
+}
+
+static void print_record(const TraceRecord& record) {
+    uint8_t x = (record.opcode >> 8) & 0xF;
+    printf("%10u  %04X  %04X  %-11s I=%04X", record.sequence, record.pc, record.opcode,
+        op_kind_names[(int)decode_kind(record.opcode)], record.i_register);
+    for (int i = 0; i < 16; i++) {
+        if (!(record.changed & (1 << i)))
+            continue;
+        if (i == x)
+            printf(" V%X=%02X", i, record.vx);
+        else if (i == 0xF)
+            printf(" VF=%02X", record.vf);
+        else
+            printf(" V%X", i);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    bool summary = false;
+    uint64_t from = 0;
+    uint64_t count = ~0ull;
+    for (int i = 2; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--summary") == 0)
+            summary = true;
+        else if (strcmp(argv[i], "--from") == 0 && has_value)
+            from = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "--count") == 0 && has_value)
+            count = strtoull(argv[++i], nullptr, 0);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        printf("Can't read %s\n", argv[1]);
+        return 1;
+    }
+    char magic[8];
+    uint32_t header[2];
+    if (fread(magic, 1, 8, file) != 8 || memcmp(magic, TRACE_MAGIC, 8) != 0 || fread(header, sizeof(header), 1, file) != 1) {
+        printf("%s is not a trace\n", argv[1]);
+        return 1;
+    }
+    if (header[0] != TRACE_VERSION || header[1] != sizeof(TraceRecord)) {
+        printf("%s was written by an incompatible build\n", argv[1]);
+        return 1;
+    }
+
+    uint64_t kind_counts[(int)OpKind::Count]{};
+    uint64_t records = 0, dropped = 0, printed = 0;
+    uint32_t expected = 0;
+    TraceRecord batch[TRACE_DRAIN_BATCH];
+    size_t read;
+    while ((read = fread(batch, sizeof(TraceRecord), TRACE_DRAIN_BATCH, file)) > 0) {
+        for (size_t i = 0; i < read; i++) {
+            const TraceRecord& record = batch[i];
+            if (record.sequence != expected) {
+                dropped += record.sequence - expected;
+                if (!summary && records >= from && printed < count)
+                    printf("-- %u records dropped\n", record.sequence - expected);
+            }
+            expected = record.sequence + 1;
+            if (summary)
+                kind_counts[(int)decode_kind(record.opcode)]++;
+            else if (records >= from && printed < count) {
+                print_record(record);
+                printed++;
+            }
+            records++;
+        }
+    }
+    fclose(file);
+
+    if (summary) {
+        for (int kind = 0; kind < (int)OpKind::Count; kind++) {
+            if (kind_counts[kind])
+                printf("%-11s %12llu  %5.1f%%\n", op_kind_names[kind], (unsigned long long)kind_counts[kind], 100.0 * kind_counts[kind] / records);
+        }
+    }
+    printf("%llu records, %llu dropped\n", (unsigned long long)records, (unsigned long long)dropped);
+    return 0;
+}
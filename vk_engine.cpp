@@ -2,7 +2,7 @@
 #include "vk_types.h"
 #include "vk_init.h"
 #include "gui.h"
-#include "Emulator.h"
+#include "Debugger.h"
 
 #define SDL_MAIN_HANDLED
 #include "imgui.h"
@@ -128,6 +128,7 @@ void VulkanEngine::run() {
     int counter = 0;
     Gui gui;
     Emulator emulator{ display };
+    Debugger debugger{ emulator };
     while (!done)
     {
         // Poll and handle events (inputs, window resize, etc.)
@@ -163,8 +164,8 @@ void VulkanEngine::run() {
             swap_chain_rebuild = false;
         }
 
-        emulator.tick();
-        gui.render(this, emulator);
+        debugger.tick();
+        gui.render(this, debugger);
     }
 }
 